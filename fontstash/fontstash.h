@@ -53,6 +53,24 @@ enum FONSeffectType {
     FONS_EFFECT_GROW = 2,
     FONS_EFFECT_DISTANCE_FIELD = 3,
     FONS_EFFECT_DISTANCE_FIELD_FAST = 4,
+    // Multi-channel distance field built from the glyph outline, stored in the RGB atlas page.
+    FONS_EFFECT_MSDF = 5,
+};
+
+// Distance transform used by FONS_EFFECT_DISTANCE_FIELD and FONS_EFFECT_GROW.
+enum FONSsdfEngine {
+    // Sweep-and-update transform (sdfBuildDistanceField), default.
+    FONS_SDF_SWEEP = 0,
+    // Linear time separable transform (sdfBuildDistanceFieldEDT), faster on large glyphs and radii.
+    FONS_SDF_EDT = 1,
+    // Propagation limited to the radius around the outline (sdfBuildDistanceFieldNarrowBand), fastest on large glyphs.
+    FONS_SDF_NARROW_BAND = 2,
+    // Fixed point separable transform (sdfBuildDistanceFieldEDTFixed) for targets with slow floating point,
+    // FONS_EFFECT_DISTANCE_FIELD_FAST then uses sdfCoverageToDistanceFieldFixed too.
+    FONS_SDF_FIXED = 3,
+    // FreeType's own distance field renderer (FT_RENDER_MODE_SDF, FreeType 2.11 or newer), built from the outline
+    // instead of the coverage for blurs of 2 to 32. Falls back to FONS_SDF_SWEEP in other cases.
+    FONS_SDF_FREETYPE = 4,
 };
 
 enum FONSerrorCode {
@@ -84,6 +102,9 @@ struct FONSparams {
     void (*renderDraw)(void* uptr, const float* verts, const float* tcoords, const unsigned int* colors, int nverts);
     void (*renderDelete)(void* uptr);
     void (*pushQuad)(void* uptr, const FONSquad* quad);
+    // Optional, called with three bytes per pixel data when the RGB (FONS_EFFECT_MSDF) atlas page changes.
+    // The quads of one fonsDrawText call all sample the same page, the RGB one for FONS_EFFECT_MSDF.
+    void (*renderUpdateRGB)(void* uptr, int* rect, const unsigned char* data);
 };
 typedef struct FONSparams FONSparams;
 
@@ -105,6 +126,8 @@ typedef struct FONScontext FONScontext;
 
 typedef struct FONSshaping FONSshaping;
 
+typedef struct FONSshapedRun FONSshapedRun;
+
 // Contructor and destructor.
 FONScontext* fonsCreateInternal(FONSparams* params);
 void fonsDeleteInternal(FONScontext* s);
@@ -116,6 +139,14 @@ void fonsGetAtlasSize(FONScontext* s, int* width, int* height);
 int fonsExpandAtlas(FONScontext* s, int width, int height, const char);
 // Reseta the whole stash.
 int fonsResetAtlas(FONScontext* stash, int width, int height, const char);
+// Selects the distance transform used for glyphs rasterized after the call, see FONSsdfEngine.
+void fonsSetSDFEngine(FONScontext* s, int engine);
+// Stores FONS_EFFECT_DISTANCE_FIELD glyphs rasterized after the call at 1/factor of the resolution (1 to 4), default 1.
+void fonsSetSDFDownsample(FONScontext* s, int factor);
+// Rasterizes all FONS_EFFECT_DISTANCE_FIELD glyphs once with the given spread (blur) in pixels, 0 to disable.
+// Text drawn with any blur then shares the same atlas entries, and outlines, glows and shadows are left to the shader.
+void fonsSetSDFSpread(FONScontext* s, float spread);
+float fonsGetSDFSpread(FONScontext* s);
 
 // Add fonts
 int fonsAddFont(FONScontext* s, const char* name, const char* path);
@@ -140,6 +171,8 @@ void fonsSetFont(FONScontext* s, int font);
 // Draw text
 float fonsDrawText(FONScontext* s, float x, float y, const char* string, const char* end, const char c);
 
+// Checks that all glyphs of a string are in the font, cacheshaping keeps the shaping state
+// for the following fonsDrawText, which then finds the string in the shaping cache.
 bool fonsTextDrawable(FONScontext* stash, const char* string, const char* end, char cacheshaping);
 
 // Measure text
@@ -158,10 +191,45 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, struct FONSquad* qu
 // Pull texture changes
 const unsigned char* fonsGetTextureData(FONScontext* stash, int* width, int* height);
 int fonsValidateTexture(FONScontext* s, int* dirty);
+// Same as above for the RGB atlas page used by FONS_EFFECT_MSDF glyphs, NULL until the first such glyph.
+const unsigned char* fonsGetTextureDataRGB(FONScontext* stash, int* width, int* height);
+int fonsValidateTextureRGB(FONScontext* s, int* dirty);
 
 // Font shaping
 void fonsSetShaping(FONScontext* stash);
 void fonsSetShaping(FONScontext* stash, FONSscript script, FONSdirection direction, FONSlanguage language);
+// Sets the OpenType features applied when shaping as a comma separated list in the HarfBuzz syntax,
+// for example "-liga,-kern" to skip ligatures and kerning, NULL or "" for the font defaults.
+void fonsSetShapingFeatures(FONScontext* stash, const char* features);
+// Returns how many shaped strings were found in the shaping cache and how many had to be shaped.
+void fonsGetShapingCacheStats(FONScontext* stash, int* hits, int* misses);
+
+// Shaped runs
+// Shapes a string with the current font, size and shaping properties into a run owned by the caller,
+// NULL when the font has no shaper. Runs don't depend on the context shaping state and can be drawn in any order.
+FONSshapedRun* fonsShapeRun(FONScontext* stash, const char* string, const char* end);
+// Same as above with the run placed in size bytes of pointer aligned caller memory, for example a per frame arena.
+// needed is set to the bytes the run takes, rounded up to keep the next run aligned, NULL is returned when it
+// doesn't fit. Such runs are not passed to fonsFreeRun.
+FONSshapedRun* fonsShapeRunInto(FONScontext* stash, const char* string, const char* end, void* mem, int size, int* needed);
+// Draws a run with the font and size it was shaped with, and the current color, blur and vertical alignment.
+float fonsDrawRun(FONScontext* stash, float x, float y, const FONSshapedRun* run, const char clear);
+// Returns the advance of a run drawn at x,y and its bounding box when bounds is not NULL.
+float fonsRunBounds(FONScontext* stash, float x, float y, const FONSshapedRun* run, float* bounds);
+int fonsRunGlyphCount(const FONSshapedRun* run);
+void fonsFreeRun(FONSshapedRun* run);
+// Shapes count strings with the current font, size and shaping properties into runs freed with fonsFreeRun,
+// lengths can be NULL for nul terminated strings. With FONS_USE_THREADS the strings missing from the shaping
+// cache are shaped on the worker threads. Returns the number of runs created, runs[i] is NULL when one failed.
+int fonsShapeBatch(FONScontext* stash, const char** strings, const int* lengths, int count, FONSshapedRun** runs);
+// Shapes a run again after an edit of the string it was shaped from, the bytes [start, start+removed) of the old
+// string being replaced by the bytes [start, start+inserted) of the new one. Only the words around the edit are
+// shaped, with the rest of the string as context, and spliced into a new run freed with fonsFreeRun, run is left
+// as is. The current shaping properties are expected to be those of the run. The whole string is shaped when the
+// current font or size aren't those of the run or when the edit can't be shaped on its own, words being taken
+// from space to space.
+FONSshapedRun* fonsReshapeRun(FONScontext* stash, const FONSshapedRun* run, const char* string, const char* end,
+                              int start, int removed, int inserted);
 unsigned int fonsDecUTF8(unsigned int* state, unsigned int byte);
 
 #endif // FONTSTASH_H
@@ -184,9 +252,53 @@ typedef struct FONSscript {} FONSscript;
 
 typedef struct FONSttFontImpl FONSttFontImpl;
 
+// Glyph outline flattened to closed polygons, in font units.
+struct FONSoutline
+{
+    float* pts;
+    unsigned char* smooth;	// Set for points inside of a flattened curve, these are never corners.
+    int* contours;			// Number of points per contour.
+    int npts, cpts;
+    int ncontours, ccontours;
+    int start;				// First point of the contour being built.
+    int nomem;
+    float tol;				// Flattening tolerance in font units.
+};
+typedef struct FONSoutline FONSoutline;
+
+// View of a glyph in the font outline cache, in font units. Valid until the next cache miss.
+struct FONSglyphOutline
+{
+    const float* pts;
+    const unsigned char* smooth;
+    const int* contours;
+    int npts, ncontours;
+    float bounds[4];
+    int advance;
+};
+typedef struct FONSglyphOutline FONSglyphOutline;
+
 int fons__tt_initShaper(FONSttFontImpl* font);
 void fons__tt_freeShaper(FONSttFontImpl* font);
 
+static void fons__outlineMoveTo(FONSoutline* outline, float x, float y);
+static void fons__outlineLineTo(FONSoutline* outline, float x, float y);
+static void fons__outlineQuadTo(FONSoutline* outline, float cx, float cy, float x, float y);
+#ifdef FONS_USE_FREETYPE
+static void fons__outlineCubicTo(FONSoutline* outline, float c1x, float c1y, float c2x, float c2y, float x, float y);
+#endif
+static void fons__outlineClose(FONSoutline* outline);
+static unsigned int fons__decutf8(unsigned int* state, unsigned int* codep, unsigned int byte);
+
+#ifdef FONS_USE_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+#if defined(FONS_NO_SIMD) && !defined(SDF_NO_SIMD)
+#	define SDF_NO_SIMD
+#endif
 #define SDF_IMPLEMENTATION
 #include "sdf.h"
 
@@ -197,7 +309,20 @@ void fons__tt_freeShaper(FONSttFontImpl* font);
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_ADVANCES_H
+#include FT_OUTLINE_H
+#include FT_TRUETYPE_TABLES_H
+#include FT_TRUETYPE_TAGS_H
 #include <math.h>
+#include <limits.h>
+
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+#	define FONS_FT_SDF
+#	include FT_MODULE_H
+#endif
+
+#ifdef FONS_USE_HARFBUZZ
+#include <hb-ot.h>
+#endif
 
 struct FONSttFontImpl {
     FT_Face font;
@@ -206,6 +331,9 @@ struct FONSttFontImpl {
 typedef struct FONSttFontImpl FONSttFontImpl;
 
 static FT_Library ftLibrary;
+#ifdef FONS_FT_SDF
+static int ftSdfSpread = 0; // Spread last set on the sdf module, it is a library wide property.
+#endif
 
 int fons__tt_init(FONScontext *stash)
 {
@@ -215,26 +343,35 @@ int fons__tt_init(FONScontext *stash)
     return ftError == 0;
 }
 
-int fons__tt_loadFont(FONScontext *context, FONSttFontImpl *font, unsigned char *data, int dataSize)
+// Opens a face on the font data, the worker shapers open their own ones the same way.
+static FT_Error fons__tt_newFace(unsigned char *data, int dataSize, FT_Face *face)
 {
     FT_Error ftError;
-    FONS_NOTUSED(context);
 
-    //font->font.userdata = stash;
-    ftError = FT_New_Memory_Face(ftLibrary, (const FT_Byte*)data, dataSize, 0, &font->font);
+    ftError = FT_New_Memory_Face(ftLibrary, (const FT_Byte*)data, dataSize, 0, face);
+    if (ftError) return ftError;
 
-    bool setcharmap = false;
     // force USC-2
-    for(int i = 0; i < font->font->num_charmaps; i++) {
-        if (((  font->font->charmaps[i]->platform_id == 0)
-            && (font->font->charmaps[i]->encoding_id == 3))
-           || ((font->font->charmaps[i]->platform_id == 3)
-            && (font->font->charmaps[i]->encoding_id == 1))) {
-                ftError = FT_Set_Charmap(font->font, font->font->charmaps[i]);
-                setcharmap = true;
+    for(int i = 0; i < (*face)->num_charmaps; i++) {
+        if (((  (*face)->charmaps[i]->platform_id == 0)
+            && ((*face)->charmaps[i]->encoding_id == 3))
+           || (((*face)->charmaps[i]->platform_id == 3)
+            && ((*face)->charmaps[i]->encoding_id == 1))) {
+                ftError = FT_Set_Charmap(*face, (*face)->charmaps[i]);
                 break;
         }
     }
+    return ftError;
+}
+
+int fons__tt_loadFont(FONScontext *context, FONSttFontImpl *font, unsigned char *data, int dataSize)
+{
+    FT_Error ftError;
+    FONS_NOTUSED(context);
+
+    //font->font.userdata = stash;
+    ftError = fons__tt_newFace(data, dataSize, &font->font);
+    if (font->font == NULL) return 0;
 
     fons__tt_initShaper(font);
     return ftError == 0;
@@ -302,18 +439,166 @@ void fons__tt_renderGlyphBitmap(FONSttFontImpl *font, unsigned char *output, int
     FONS_NOTUSED(scaleY);
     FONS_NOTUSED(glyph);	// glyph has already been loaded by fons__tt_buildGlyphBitmap
 
-    for ( y = 0; y < ftGlyph->bitmap.rows; y++ ) {
-        for ( x = 0; x < ftGlyph->bitmap.width; x++ ) {
+    for ( y = 0; y < (int)ftGlyph->bitmap.rows; y++ ) {
+        for ( x = 0; x < (int)ftGlyph->bitmap.width; x++ ) {
             output[(y * outStride) + x] = ftGlyph->bitmap.buffer[ftGlyphOffset++];
         }
     }
 }
 
-int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
+// Renders the distance field of the glyph with FreeType into the tile at ox,oy in glyph pixel coordinates,
+// the one pixel border of the tile is left alone. Returns 0 if the renderer is not available.
+int fons__tt_renderGlyphSDF(FONSttFontImpl *font, int glyph, float size, int spread,
+                            unsigned char *output, int outWidth, int outHeight, int outStride, int ox, int oy)
+{
+#ifdef FONS_FT_SDF
+    FT_GlyphSlot ftGlyph;
+    FT_Int ftSpread = spread;
+    int x, y, bx, by;
+
+    // The spread of the sdf module is limited to 2..32 pixels.
+    if (spread < 2 || spread > 32) return 0;
+    if (fons__tt_setPixelSize(font, size)) return 0;
+    if (FT_Load_Glyph(font->font, glyph, FT_LOAD_DEFAULT)) return 0;
+    if (spread != ftSdfSpread) {
+        if (FT_Property_Set(ftLibrary, "sdf", "spread", &ftSpread)) return 0;
+        if (FT_Property_Set(ftLibrary, "bsdf", "spread", &ftSpread)) return 0;
+        ftSdfSpread = spread;
+    }
+    ftGlyph = font->font->glyph;
+    if (FT_Render_Glyph(ftGlyph, FT_RENDER_MODE_SDF)) return 0;
+
+    // FreeType stores 128 + 128 * distance / spread with the inside positive, sdfBuildDistanceField
+    // stores (0.5 - 0.5 * distance / radius) * 255 with the outside positive, so the value is scaled by 255/256.
+    bx = ftGlyph->bitmap_left - ox;
+    by = -ftGlyph->bitmap_top - oy;
+    for (y = 0; y < (int)ftGlyph->bitmap.rows; y++) {
+        const unsigned char* src = &ftGlyph->bitmap.buffer[y * ftGlyph->bitmap.pitch];
+        int ty = by + y;
+        if (ty < 1 || ty >= outHeight-1) continue;
+        for (x = 0; x < (int)ftGlyph->bitmap.width; x++) {
+            int tx = bx + x;
+            if (tx < 1 || tx >= outWidth-1) continue;
+            output[tx + ty * outStride] = (unsigned char)((src[x] * 255) >> 8);
+        }
+    }
+    return 1;
+#else
+    FONS_NOTUSED(font);
+    FONS_NOTUSED(glyph);
+    FONS_NOTUSED(size);
+    FONS_NOTUSED(spread);
+    FONS_NOTUSED(output);
+    FONS_NOTUSED(outWidth);
+    FONS_NOTUSED(outHeight);
+    FONS_NOTUSED(outStride);
+    FONS_NOTUSED(ox);
+    FONS_NOTUSED(oy);
+    return 0;
+#endif
+}
+
+static int fons__ftMoveTo(const FT_Vector* to, void* user)
+{
+    fons__outlineMoveTo((FONSoutline*)user, (float)to->x, (float)to->y);
+    return 0;
+}
+
+static int fons__ftLineTo(const FT_Vector* to, void* user)
+{
+    fons__outlineLineTo((FONSoutline*)user, (float)to->x, (float)to->y);
+    return 0;
+}
+
+static int fons__ftConicTo(const FT_Vector* control, const FT_Vector* to, void* user)
+{
+    fons__outlineQuadTo((FONSoutline*)user, (float)control->x, (float)control->y, (float)to->x, (float)to->y);
+    return 0;
+}
+
+static int fons__ftCubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user)
+{
+    fons__outlineCubicTo((FONSoutline*)user, (float)control1->x, (float)control1->y,
+                         (float)control2->x, (float)control2->y, (float)to->x, (float)to->y);
+    return 0;
+}
+
+int fons__tt_getGlyphOutline(FONSttFontImpl *font, int glyph, FONSoutline* outline)
+{
+    FT_Error ftError;
+    FT_Outline_Funcs funcs;
+
+    // Unscaled and unhinted, the outline is returned in font units.
+    ftError = FT_Load_Glyph(font->font, glyph, FT_LOAD_NO_SCALE);
+    if (ftError) return 0;
+    if (font->font->glyph->format != FT_GLYPH_FORMAT_OUTLINE) return 0;
+
+    funcs.move_to = fons__ftMoveTo;
+    funcs.line_to = fons__ftLineTo;
+    funcs.conic_to = fons__ftConicTo;
+    funcs.cubic_to = fons__ftCubicTo;
+    funcs.shift = 0;
+    funcs.delta = 0;
+    ftError = FT_Outline_Decompose(&font->font->glyph->outline, &funcs, outline);
+    fons__outlineClose(outline);
+    return ftError == 0;
+}
+
+int fons__tt_getGlyphAdvance(FONSttFontImpl *font, int glyph)
+{
+    FT_Fixed advance = 0;
+    FT_Get_Advance(font->font, glyph, FT_LOAD_NO_SCALE, &advance);
+    return (int)advance;
+}
+
+void fons__tt_renderGlyphOutline(FONScontext *stash, FONSttFontImpl *font, unsigned char *output, int outWidth, int outHeight,
+                                 int outStride, float scale, int x0, int y0, const FONSglyphOutline* outline)
+{
+    FT_Outline ftOutline;
+    FT_Bitmap ftBitmap;
+    int i;
+    FONS_NOTUSED(stash);
+    FONS_NOTUSED(font);
+
+    if (outline->npts == 0 || outline->npts > SHRT_MAX || outline->ncontours > SHRT_MAX) return;
+    if (FT_Outline_New(ftLibrary, outline->npts, outline->ncontours, &ftOutline)) return;
+
+    // Scale to 26.6 pixels, FreeType bitmaps have origin at bottom left.
+    for (i = 0; i < outline->npts; i++) {
+        ftOutline.points[i].x = (FT_Pos)((outline->pts[i*2+0] * scale - x0) * 64.0f);
+        ftOutline.points[i].y = (FT_Pos)((outline->pts[i*2+1] * scale + y0 + outHeight) * 64.0f);
+        ftOutline.tags[i] = FT_CURVE_TAG_ON;
+    }
+    for (i = 0; i < outline->ncontours; i++)
+        ftOutline.contours[i] = (i > 0 ? ftOutline.contours[i-1] : -1) + outline->contours[i];
+
+    memset(&ftBitmap, 0, sizeof(ftBitmap));
+    ftBitmap.rows = outHeight;
+    ftBitmap.width = outWidth;
+    ftBitmap.pitch = outStride;
+    ftBitmap.buffer = output;
+    ftBitmap.num_grays = 256;
+    ftBitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+    FT_Outline_Get_Bitmap(ftLibrary, &ftOutline, &ftBitmap);
+
+    FT_Outline_Done(ftLibrary, &ftOutline);
+}
+
+// Returns a copy of the kern table of the font, or NULL when it has none.
+unsigned char* fons__tt_loadKernTable(FONSttFontImpl *font, int *size)
 {
-    FT_Vector ftKerning;
-    FT_Get_Kerning(font->font, glyph1, glyph2, FT_KERNING_DEFAULT, &ftKerning);
-    return (int)ftKerning.x;
+    FT_ULong length = 0;
+    unsigned char* table;
+
+    if (FT_Load_Sfnt_Table(font->font, TTAG_kern, 0, NULL, &length) != 0 || length == 0) return NULL;
+    table = (unsigned char*)malloc(length);
+    if (table == NULL) return NULL;
+    if (FT_Load_Sfnt_Table(font->font, TTAG_kern, 0, table, &length) != 0) {
+        free(table);
+        return NULL;
+    }
+    *size = (int)length;
+    return table;
 }
 
 float fons__tt_getUnitScale()
@@ -390,9 +675,83 @@ void fons__tt_renderGlyphBitmap(FONSttFontImpl *font, unsigned char *output, int
     stbtt_MakeGlyphBitmap(&font->font, output, outWidth, outHeight, outStride, scaleX, scaleY, glyph);
 }
 
-int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
+// FONS_SDF_FREETYPE is only available with FreeType, the glyph goes through the in-tree transforms.
+int fons__tt_renderGlyphSDF(FONSttFontImpl *font, int glyph, float size, int spread,
+                            unsigned char *output, int outWidth, int outHeight, int outStride, int ox, int oy)
+{
+    FONS_NOTUSED(font);
+    FONS_NOTUSED(glyph);
+    FONS_NOTUSED(size);
+    FONS_NOTUSED(spread);
+    FONS_NOTUSED(output);
+    FONS_NOTUSED(outWidth);
+    FONS_NOTUSED(outHeight);
+    FONS_NOTUSED(outStride);
+    FONS_NOTUSED(ox);
+    FONS_NOTUSED(oy);
+    return 0;
+}
+
+int fons__tt_getGlyphOutline(FONSttFontImpl *font, int glyph, FONSoutline* outline)
+{
+    stbtt_vertex* verts = NULL;
+    int i, nverts = stbtt_GetGlyphShape(&font->font, glyph, &verts);
+
+    for (i = 0; i < nverts; i++) {
+        switch (verts[i].type) {
+            case STBTT_vmove:
+                fons__outlineMoveTo(outline, verts[i].x, verts[i].y);
+                break;
+            case STBTT_vline:
+                fons__outlineLineTo(outline, verts[i].x, verts[i].y);
+                break;
+            case STBTT_vcurve:
+                fons__outlineQuadTo(outline, verts[i].cx, verts[i].cy, verts[i].x, verts[i].y);
+                break;
+        }
+    }
+    fons__outlineClose(outline);
+
+    if (verts != NULL)
+        stbtt_FreeShape(&font->font, verts);
+    return 1;
+}
+
+int fons__tt_getGlyphAdvance(FONSttFontImpl *font, int glyph)
+{
+    int advance, lsb;
+    stbtt_GetGlyphHMetrics(&font->font, glyph, &advance, &lsb);
+    return advance;
+}
+
+void fons__tt_renderGlyphOutline(FONScontext *stash, FONSttFontImpl *font, unsigned char *output, int outWidth, int outHeight,
+                                 int outStride, float scale, int x0, int y0, const FONSglyphOutline* outline)
+{
+    stbtt__bitmap gbm;
+    FONS_NOTUSED(font);
+
+    if (outline->npts == 0 || outWidth == 0 || outHeight == 0) return;
+    gbm.pixels = output;
+    gbm.w = outWidth;
+    gbm.h = outHeight;
+    gbm.stride = outStride;
+    // The cached points are already flat, go straight to the edge rasterizer.
+    stbtt__rasterize(&gbm, (stbtt__point*)outline->pts, (int*)outline->contours, outline->ncontours,
+                     scale, scale, 0.0f, 0.0f, x0, y0, 1, stash);
+}
+
+// Returns a copy of the kern table of the font up to the end of its first subtable, or NULL when it has none.
+unsigned char* fons__tt_loadKernTable(FONSttFontImpl *font, int *size)
 {
-    return stbtt_GetGlyphKernAdvance(&font->font, glyph1, glyph2);
+    const unsigned char* data = font->font.data + font->font.kern;
+    unsigned char* table;
+
+    if (!font->font.kern || ttUSHORT(data+2) < 1) return NULL;
+    *size = 18 + ttUSHORT(data+10) * 6;
+    table = (unsigned char*)malloc(*size);
+    if (table == NULL) return NULL;
+    memcpy(table, data, *size);
+    return table;
 }
 
 float fons__tt_getUnitScale()
@@ -423,6 +782,79 @@ float fons__tt_getUnitScale()
 #ifndef FONS_MAX_STATES
 #	define FONS_MAX_STATES 20
 #endif
+#ifndef FONS_MAX_BLUR
+#	define FONS_MAX_BLUR 64
+#endif
+#ifndef FONS_BLUR_IIR_MAX
+#	define FONS_BLUR_IIR_MAX 20
+#endif
+#ifndef FONS_OUTLINE_TOLERANCE
+#	define FONS_OUTLINE_TOLERANCE (1.0f/1024.0f)
+#endif
+// Bytes of flattened outlines cached per font, the cache starts over when an outline doesn't fit.
+#ifndef FONS_OUTLINE_CACHE_SIZE
+#	define FONS_OUTLINE_CACHE_SIZE (1 << 20)
+#endif
+#ifndef FONS_MAX_THREADS
+#	define FONS_MAX_THREADS 4
+#endif
+#ifndef FONS_SDF_PARALLEL_PIXELS
+#	define FONS_SDF_PARALLEL_PIXELS 40000
+#endif
+#ifndef FONS_SDF_DEFAULT_ENGINE
+#	define FONS_SDF_DEFAULT_ENGINE FONS_SDF_SWEEP
+#endif
+// Kerning pairs of glyphs under this are looked up in a dense table (2 bytes per pair) instead of the hash.
+#ifndef FONS_KERN_DENSE_GLYPHS
+#	define FONS_KERN_DENSE_GLYPHS 256
+#endif
+#ifndef FONS_SHAPING_CACHE_SIZE
+#	define FONS_SHAPING_CACHE_SIZE 256
+#endif
+#ifndef FONS_SHAPING_CACHE_BYTES
+#	define FONS_SHAPING_CACHE_BYTES 262144
+#endif
+#ifndef FONS_SHAPING_PARALLEL_STRINGS
+#	define FONS_SHAPING_PARALLEL_STRINGS 16
+#endif
+#ifndef FONS_SHAPING_FEATURES
+#	define FONS_SHAPING_FEATURES 8
+#endif
+#ifndef FONS_SHAPING_FEATURE_SETS
+#	define FONS_SHAPING_FEATURE_SETS 8
+#endif
+#ifndef FONS_SHAPE_PLANS
+#	define FONS_SHAPE_PLANS 8
+#endif
+// Strings with no codepoint above this and nothing for the font to substitute are shaped from the cmap, advances
+// and kern table instead of HarfBuzz, 0 sends all strings to HarfBuzz.
+#ifndef FONS_SHAPING_BYPASS_MAX
+#	define FONS_SHAPING_BYPASS_MAX 0xff
+#endif
+
+#ifndef FONS_NO_SIMD
+#	if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#		define FONS_SSE2
+#		include <emmintrin.h>
+		// The SSE4.1 kernels are built for the target when the compiler allows it and picked at runtime.
+#		if defined(__SSE4_1__) || defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+#			define FONS_SSE41
+#			include <smmintrin.h>
+#		endif
+#		ifdef _MSC_VER
+#			include <intrin.h>
+#		endif
+#	elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#		define FONS_NEON
+#		include <arm_neon.h>
+#	endif
+#endif
+
+#if defined(FONS_SSE41) && !defined(__SSE4_1__) && (defined(__GNUC__) || defined(__clang__))
+#	define FONS_TARGET_SSE41 __attribute__((target("sse4.1")))
+#else
+#	define FONS_TARGET_SSE41
+#endif
 
 static unsigned int fons__hashint(unsigned int a)
 {
@@ -445,6 +877,19 @@ static int fons__maxi(int a, int b)
     return a > b ? a : b;
 }
 
+static float fons__minf(float a, float b)
+{
+    return a < b ? a : b;
+}
+
+static float fons__maxf(float a, float b)
+{
+    return a > b ? a : b;
+}
+
+// Set on the codepoint of glyphs looked up by glyph index, as given by shaping.
+#define FONS_GLYPH_INDEX 0x80000000u
+
 struct FONSglyph
 {
     unsigned int codepoint;
@@ -454,9 +899,133 @@ struct FONSglyph
     short size, blur;
     short x0,y0,x1,y1;
     short xadv,xoff,yoff;
+    short downsample;
 };
 typedef struct FONSglyph FONSglyph;
 
+struct FONSoutlineGlyph
+{
+    int glyph;
+    int next;
+    int pts, npts;
+    int contours, ncontours;
+    float bounds[4];
+    int advance;
+};
+typedef struct FONSoutlineGlyph FONSoutlineGlyph;
+
+// Per font cache of flattened outlines, all glyphs share the same point and contour arrays.
+struct FONSoutlineCache
+{
+    FONSoutlineGlyph* glyphs;
+    int nglyphs, cglyphs;
+    float* pts;
+    unsigned char* smooth;
+    int npts, cpts;
+    int* contours;
+    int ncontours, ccontours;
+    int lut[FONS_HASH_LUT_SIZE];
+};
+typedef struct FONSoutlineCache FONSoutlineCache;
+
+static void fons__freeOutlineCache(FONSoutlineCache* cache);
+
+// Kerning of a font in font units, the pairs of glyphs under FONS_KERN_DENSE_GLYPHS are in a dense table and the
+// other ones in an open addressing hash keyed by glyph1 << 16 | glyph2.
+struct FONSkerning
+{
+    short* dense;
+    unsigned int* keys;
+    short* values;
+    unsigned int mask;
+};
+typedef struct FONSkerning FONSkerning;
+
+// Big endian 16 bit value of a font table.
+static unsigned int fons__u16(const unsigned char* p)
+{
+    return (unsigned int)p[0] << 8 | p[1];
+}
+
+// Flattens the first subtable of the kern table of the font when it is horizontal and format 0, the one
+// stb_truetype reads.
+static int fons__buildKerning(FONSkerning* kerning, FONSttFontImpl* font)
+{
+    unsigned char* table;
+    const unsigned char* pair;
+    unsigned int key, size, i, j, npairs, nhashed = 0;
+    int tableSize = 0, glyph1, glyph2;
+
+    table = fons__tt_loadKernTable(font, &tableSize);
+    if (table == NULL) return 1;
+    if (tableSize < 18 || fons__u16(table+2) < 1 || fons__u16(table+8) != 1) {
+        free(table);
+        return 1;
+    }
+    npairs = fons__mini(fons__u16(table+10), (tableSize - 18) / 6);
+
+    for (i = 0, pair = table+18; i < npairs; i++, pair += 6) {
+        if (fons__u16(pair) >= FONS_KERN_DENSE_GLYPHS || fons__u16(pair+2) >= FONS_KERN_DENSE_GLYPHS)
+            nhashed++;
+    }
+    if (nhashed < npairs) {
+        kerning->dense = (short*)calloc(FONS_KERN_DENSE_GLYPHS * FONS_KERN_DENSE_GLYPHS, sizeof(short));
+        if (kerning->dense == NULL) goto error;
+    }
+    if (nhashed > 0) {
+        for (size = 16; size < nhashed * 2; size *= 2);
+        kerning->keys = (unsigned int*)calloc(size, sizeof(unsigned int));
+        kerning->values = (short*)malloc(size * sizeof(short));
+        if (kerning->keys == NULL || kerning->values == NULL) goto error;
+        kerning->mask = size - 1;
+    }
+
+    for (i = 0, pair = table+18; i < npairs; i++, pair += 6) {
+        glyph1 = fons__u16(pair);
+        glyph2 = fons__u16(pair+2);
+        if (glyph1 < FONS_KERN_DENSE_GLYPHS && glyph2 < FONS_KERN_DENSE_GLYPHS) {
+            kerning->dense[glyph1 * FONS_KERN_DENSE_GLYPHS + glyph2] = (short)fons__u16(pair+4);
+            continue;
+        }
+        key = (unsigned int)glyph1 << 16 | (unsigned int)glyph2;
+        for (j = fons__hashint(key) & kerning->mask; kerning->keys[j] != 0 && kerning->keys[j] != key;
+             j = (j+1) & kerning->mask);
+        kerning->keys[j] = key;
+        kerning->values[j] = (short)fons__u16(pair+4);
+    }
+    free(table);
+    return 1;
+
+error:
+    free(table);
+    return 0;
+}
+
+// Kerning of a pair of glyphs in font units.
+static __inline int fons__getKerning(const FONSkerning* kerning, int glyph1, int glyph2)
+{
+    unsigned int key, i;
+
+    if ((unsigned int)glyph1 < FONS_KERN_DENSE_GLYPHS && (unsigned int)glyph2 < FONS_KERN_DENSE_GLYPHS)
+        return kerning->dense != NULL ? kerning->dense[glyph1 * FONS_KERN_DENSE_GLYPHS + glyph2] : 0;
+    if (kerning->keys == NULL) return 0;
+    key = (unsigned int)glyph1 << 16 | (unsigned int)glyph2;
+    for (i = fons__hashint(key) & kerning->mask; kerning->keys[i] != 0; i = (i+1) & kerning->mask) {
+        if (kerning->keys[i] == key)
+            return kerning->values[i];
+    }
+    return 0;
+}
+
+// How a codepoint of a string shaped without HarfBuzz is affected by the default substitutions of the font.
+enum FONSsimpleClass {
+    FONS_SIMPLE_PLAIN = 0,
+    // Read by a ligature, two of them in a row need shaping.
+    FONS_SIMPLE_LIGATURE = 1,
+    // Missing, default ignorable or read by contextual alternates, always shaped.
+    FONS_SIMPLE_SHAPED = 2,
+};
+
 struct FONSfont
 {
     FONSttFontImpl font;
@@ -471,6 +1040,16 @@ struct FONSfont
     int cglyphs;
     int nglyphs;
     int lut[FONS_HASH_LUT_SIZE];
+    FONSoutlineCache outlines;
+    FONSkerning kerning;
+#ifdef FONS_USE_HARFBUZZ
+    // Glyph indices, advances in font units and FONSsimpleClass of the codepoints that may be shaped without
+    // HarfBuzz, built on first use.
+    int simpleGlyphs[FONS_SHAPING_BYPASS_MAX+1];
+    int simpleAdvances[FONS_SHAPING_BYPASS_MAX+1];
+    unsigned char simpleClasses[FONS_SHAPING_BYPASS_MAX+1];
+    int simpleReady;
+#endif
 };
 typedef struct FONSfont FONSfont;
 
@@ -507,17 +1086,98 @@ struct FONSshapingRes
     uint32_t* codepoints;
     float* advance;
     float* offset;
+    uint32_t* clusters;	// Byte offset in the string of the first character of the cluster of each glyph.
+    int simple;	// Shaped without HarfBuzz, see fons__simpleRun.
 };
 typedef struct FONSshapingRes FONSshapingRes;
 
+// Shaped string owned by the caller, the glyph arrays follow the struct in the same allocation.
+struct FONSshapedRun
+{
+    FONSshapingRes res;
+    int font;
+    short isize;
+};
+
+#ifdef FONS_USE_HARFBUZZ
+
+// String shaped with a font, size and segment properties. Its arena bytes hold the codepoints,
+// advances, offsets and clusters of the result followed by the text, so hits are checked against the text.
+struct FONSshapingEntry
+{
+    unsigned int hash;
+    FONSfont* font;
+    short isize;
+    bool customConfig;
+    FONSscript script;
+    FONSdirection direction;
+    FONSlanguage language;
+    int featureSet;
+    int textLength;
+    unsigned int glyphCount;
+    int simple;
+    int data, size;
+    unsigned int lastUse;
+    int next;
+};
+typedef struct FONSshapingEntry FONSshapingEntry;
+
+// Bounded LRU cache of shaping results, entries are kept in arena order so evicting only needs
+// to slide the remaining data down.
+struct FONSshapingCache
+{
+    FONSshapingEntry entries[FONS_SHAPING_CACHE_SIZE];
+    int nentries;
+    int lut[FONS_HASH_LUT_SIZE];
+    unsigned char* arena;
+    int narena;
+    unsigned char* large;	// Result of a string too long for the arena, replaced by the next one.
+    int clarge;
+    unsigned int clock;
+    int hits, misses;
+};
+typedef struct FONSshapingCache FONSshapingCache;
+
+struct FONSfeatureSet
+{
+    hb_feature_t features[FONS_SHAPING_FEATURES];
+    int nfeatures;
+};
+typedef struct FONSfeatureSet FONSfeatureSet;
+
+#endif
+
 struct FONSshaping {
     FONSshapingRes* result;
+    FONSshapingRes view;	// Points in the shaping cache, valid until the next string is shaped.
     FONSscript script;
     FONSdirection direction;
     FONSlanguage language;
     bool customConfig;
-    int it;
+#ifdef FONS_USE_HARFBUZZ
+    FONSshapingCache cache;
+    // Feature sets passed to fonsSetShapingFeatures, their index keys the cached results and shape plans.
+    FONSfeatureSet featureSets[FONS_SHAPING_FEATURE_SETS];
+    int nfeatureSets;
+    int featureSet;
+#endif
+};
+
+// Pixel kernels picked for the running CPU when the context is created, each one has a scalar
+// version and the vector versions produce the same output.
+struct FONSkernels
+{
+    void (*blurRowStep)(unsigned char* row, int* z, int w, int alpha);
+    void (*growRow)(unsigned char* dst, const unsigned char* src, int w, const unsigned char* lut, int limit);
+    int (*decodeASCII)(const unsigned char* src, int n, unsigned int* dst);
+#ifdef FONS_USE_COVERAGE_RASTERIZER
+    float (*accumulateRow)(const float* acc, unsigned char* dst, int w, float sum);
+#endif
+    int sdfIsa; // Instruction set passed to sdfCoverageToDistanceFieldISA.
 };
+typedef struct FONSkernels FONSkernels;
+
+static void fons__initKernels(FONSkernels* k);
 
 struct FONScontext
 {
@@ -540,102 +1200,632 @@ struct FONScontext
     void (*handleError)(void* uptr, int error, int val);
     void* errorUptr;
     FONSshaping* shaping;
+    FONSoutline outline;
+    unsigned char* texDataRGB;
+    FONSatlas* atlasRGB;
+    int dirtyRectRGB[4];
+    int sdfEngine;
+    int sdfDownsample;
+    short sdfSpread;
+    unsigned char growLut[256];
+    int growBlur;
+    FONSkernels kernels;
+    unsigned int* codepoints;	// Codepoints of the last string decoded by fons__decodeText.
+    int ccodepoints;
+    const char* decodedStr;		// The last decoded string and a copy of its bytes, so that a string that is
+    char* decodedText;			// measured and then drawn is only decoded once.
+    int decodedLen, ndecoded;
+#ifdef FONS_USE_THREADS
+    struct FONSthreadPool* pool;
+#endif
 };
 
+// Points a shaping result at glyphCount codepoints, advances, offsets and clusters stored one after the other.
+static void fons__shapingView(FONSshapingRes* res, unsigned char* data, unsigned int glyphCount)
+{
+    res->glyphCount = glyphCount;
+    res->codepoints = (uint32_t*)data;
+    res->advance = (float*)(data + glyphCount * sizeof(uint32_t));
+    res->offset = res->advance + glyphCount * 2;
+    res->clusters = (uint32_t*)(res->offset + glyphCount * 2);
+    res->simple = 0;
+}
+
+static size_t fons__runGlyphBytes(unsigned int glyphCount)
+{
+    return glyphCount * (sizeof(uint32_t) * 2 + sizeof(float) * 4);
+}
+
+// Allocates a run with room for glyphCount glyphs.
+static FONSshapedRun* fons__allocRun(unsigned int glyphCount)
+{
+    FONSshapedRun* run = (FONSshapedRun*) malloc(sizeof(FONSshapedRun) + fons__runGlyphBytes(glyphCount));
+    if (run == NULL) return NULL;
+    fons__shapingView(&run->res, (unsigned char*)(run + 1), glyphCount);
+    return run;
+}
+
 #ifdef FONS_USE_HARFBUZZ
 
+struct FONShbPlan
+{
+    hb_segment_properties_t props;
+    int featureSet;
+    hb_shape_plan_t* plan;
+    unsigned int lastUse;
+};
+typedef struct FONShbPlan FONShbPlan;
+
 struct FONShbFontShaper
 {
     hb_font_t* font;
     hb_buffer_t* buffer;
+    FT_Face face;
+    // 26.6 units per em of the text last shaped, the font itself shapes in font units.
+    int scale;
+    // Shape plans of the segment properties and feature sets used with the font, least recently used replaced.
+    FONShbPlan plans[FONS_SHAPE_PLANS];
+    int nplans;
+    unsigned int clock;
+#ifdef FONS_USE_THREADS
+    // Shapers of the batch jobs with their own faces, job 0 uses the font one.
+    struct FONShbFontShaper* workers[FONS_MAX_THREADS];
+#endif
 };
 
 typedef struct FONShbFontShaper FONShbFontShaper;
 
-int fons__tt_initShaper(FONSttFontImpl* font)
+// Scale of the HarfBuzz font for text of isize/10 pixels, 26.6 units per em.
+static int fons__hbScale(short isize)
 {
-    FONShbFontShaper* shaper = (FONShbFontShaper *) malloc(sizeof(FONShbFontShaper));
+    return (isize * 64 + 5) / 10;
+}
 
-    shaper->font = hb_ft_font_create(font->font, NULL);
-    shaper->buffer = hb_buffer_create();
+// Font units to 26.6 units at scale 26.6 units per em, rounded to nearest.
+static hb_position_t fons__hbScaleUnits(int units, int scale, int unitsPerEm)
+{
+    long long v = (long long)units * scale;
+    return (hb_position_t)(v >= 0 ? (v + unitsPerEm/2) / unitsPerEm : -((-v + unitsPerEm/2) / unitsPerEm));
+}
 
-    font->shaper = shaper;
+// Advance of the HarfBuzz font in font units, the unhinted one fons__simpleShape uses, where hb-ft would use
+// FreeType's advance at the integer pixel size of the face.
+static hb_position_t fons__hbGlyphAdvance(hb_font_t* font, void* fontData, hb_codepoint_t glyph, void* userData)
+{
+    FT_Fixed advance;
+    FONS_NOTUSED(font);
+    FONS_NOTUSED(userData);
 
-    return hb_buffer_allocation_successful(shaper->buffer);
+    if (FT_Get_Advance((FT_Face)fontData, glyph, FT_LOAD_NO_SCALE, &advance) != 0) return 0;
+    return (hb_position_t)advance;
 }
 
-void fons__tt_freeShaper(FONSttFontImpl* font)
+// Fills the glyph indices, advances and classes of the codepoints up to FONS_SHAPING_BYPASS_MAX, the classes from
+// the glyphs read by the ligature and contextual alternate lookups of the font in any script.
+static void fons__hbSimpleGlyphs(FONSfont* font)
 {
-    FONShbFontShaper* shaper = (FONShbFontShaper*)font->shaper;
-    if(shaper) {
-        hb_buffer_destroy(shaper->buffer);
-        hb_font_destroy(shaper->font);
-        free(shaper);
+    static const hb_tag_t ligatures[] = { HB_TAG('l','i','g','a'), HB_TAG('c','l','i','g'), HB_TAG('r','l','i','g'), HB_TAG_NONE };
+    static const hb_tag_t contextual[] = { HB_TAG('c','a','l','t'), HB_TAG_NONE };
+    FONShbFontShaper* shaper = (FONShbFontShaper*)font->font.shaper;
+    hb_face_t* face = hb_font_get_face(shaper->font);
+    hb_set_t* lookups = hb_set_create();
+    hb_set_t* ligated = hb_set_create();
+    hb_set_t* shaped = hb_set_create();
+    hb_codepoint_t lookup;
+    FT_Fixed advance;
+    int g, cp;
+
+    hb_ot_layout_collect_lookups(face, HB_OT_TAG_GSUB, NULL, NULL, ligatures, lookups);
+    for (lookup = HB_SET_VALUE_INVALID; hb_set_next(lookups, &lookup); )
+        hb_ot_layout_lookup_collect_glyphs(face, HB_OT_TAG_GSUB, lookup, NULL, ligated, NULL, NULL);
+    hb_set_clear(lookups);
+    hb_ot_layout_collect_lookups(face, HB_OT_TAG_GSUB, NULL, NULL, contextual, lookups);
+    for (lookup = HB_SET_VALUE_INVALID; hb_set_next(lookups, &lookup); )
+        hb_ot_layout_lookup_collect_glyphs(face, HB_OT_TAG_GSUB, lookup, shaped, shaped, shaped, NULL);
+
+    for (cp = 0; cp <= FONS_SHAPING_BYPASS_MAX; cp++) {
+        g = fons__tt_getGlyphIndex(&font->font, cp, 0);
+        if (g != 0 && FT_Get_Advance(shaper->face, g, FT_LOAD_NO_SCALE, &advance) != 0)
+            g = 0;
+        font->simpleGlyphs[cp] = g;
+        font->simpleAdvances[cp] = g != 0 ? (int)advance : 0;
+        if (g == 0 || cp == 0xad || hb_set_has(shaped, g))
+            font->simpleClasses[cp] = FONS_SIMPLE_SHAPED;
+        else if (hb_set_has(ligated, g))
+            font->simpleClasses[cp] = FONS_SIMPLE_LIGATURE;
+        else
+            font->simpleClasses[cp] = FONS_SIMPLE_PLAIN;
     }
+    font->simpleReady = 1;
+
+    hb_set_destroy(lookups);
+    hb_set_destroy(ligated);
+    hb_set_destroy(shaped);
 }
 
-void fons__hb_shape(FONScontext* stash, const char* text, FONSfont* font)
+// Number of glyphs of a string that needs nothing beyond the cmap and kerning, 0 when it needs HarfBuzz: left to
+// right with the default features, no codepoint above FONS_SHAPING_BYPASS_MAX and none the font substitutes.
+static unsigned int fons__simpleRun(const FONSshaping* shaping, FONSfont* font, const char* text, int len)
 {
-    FONSshaping* shaping;
-    FONSshapingRes* res;
-    FONShbFontShaper* shaper;
-    hb_buffer_t* buffer;
-    hb_font_t* ft;
-    int i,j;
+    const char* end = text + len;
+    unsigned int codepoint;
+    unsigned int utf8state = 0;
+    unsigned int glyphCount = 0;
+    int cls, prev = FONS_SIMPLE_PLAIN;
 
-    shaper = (FONShbFontShaper *) font->font.shaper;
-    shaping = stash->shaping;
-    res = shaping->result;
-    buffer = shaper->buffer;
-    ft = shaper->font;
+    if (shaping->featureSet != 0) return 0;
+    if (shaping->customConfig && shaping->direction != HB_DIRECTION_LTR) return 0;
+    if (!font->simpleReady)
+        fons__hbSimpleGlyphs(font);
 
-    hb_buffer_reset(buffer);
-    hb_buffer_add_utf8(buffer, text, (int)strlen(text), 0, (int)strlen(text));
+    for (; text != end; ++text) {
+        if (fons__decutf8(&utf8state, &codepoint, *(const unsigned char*)text))
+            continue;
+        if (codepoint > FONS_SHAPING_BYPASS_MAX) return 0;
+        cls = font->simpleClasses[codepoint];
+        if (cls == FONS_SIMPLE_SHAPED || (cls == FONS_SIMPLE_LIGATURE && prev == FONS_SIMPLE_LIGATURE)) return 0;
+        prev = cls;
+        glyphCount++;
+    }
+    return utf8state == 0 ? glyphCount : 0;
+}
 
-    if (shaping->customConfig) {
-        hb_buffer_set_direction(buffer, shaping->direction);
-        hb_buffer_set_script(buffer, shaping->script);
-        hb_buffer_set_language(buffer, shaping->language);
+// Shapes the bytes [offset, offset+length) of a string checked by fons__simpleRun into res, in the 26.6 units
+// of HarfBuzz with the kerning folded into the advances, the last glyph is kerned with the character after them.
+// Each advance is rounded with its kerning from font units like fons__hbStoreGlyphs does.
+static void fons__simpleShape(const FONSfont* font, FT_Face face, const char* text, int len, int offset, int length,
+                              short isize, FONSshapingRes* res)
+{
+    const char* str = text + offset;
+    const char* end = str + length;
+    const char* first = str;
+    int scale = fons__hbScale(isize), upem = face->units_per_EM;
+    unsigned int codepoint;
+    unsigned int utf8state = 0;
+    unsigned int i = 0;
+
+    for (; str != end; ++str) {
+        if (fons__decutf8(&utf8state, &codepoint, *(const unsigned char*)str))
+            continue;
+        res->codepoints[i] = font->simpleGlyphs[codepoint];
+        res->advance[i*2] = (float)font->simpleAdvances[codepoint];
+        res->advance[i*2+1] = 0.0f;
+        res->offset[i*2] = 0.0f;
+        res->offset[i*2+1] = 0.0f;
+        res->clusters[i] = (uint32_t)(first - text);
+        first = str + 1;
+        if (i > 0) {
+            res->advance[i*2-2] += (float)fons__getKerning(&font->kerning, res->codepoints[i-1], res->codepoints[i]);
+            res->advance[i*2-2] = (float)fons__hbScaleUnits((int)res->advance[i*2-2], scale, upem);
+        }
+        i++;
+    }
+    if (i == 0) return;
+
+    if (end != text + len) {
+        for (; str != text + len; ++str) {
+            if (!fons__decutf8(&utf8state, &codepoint, *(const unsigned char*)str))
+                break;
+        }
+        if (str != text + len)
+            res->advance[i*2-2] += (float)fons__getKerning(&font->kerning, res->codepoints[i-1], font->simpleGlyphs[codepoint]);
+    }
+    res->advance[i*2-2] = (float)fons__hbScaleUnits((int)res->advance[i*2-2], scale, upem);
+}
+
+static FONShbFontShaper* fons__hbCreateShaper(FT_Face face)
+{
+    FONShbFontShaper* shaper = (FONShbFontShaper *) calloc(1, sizeof(FONShbFontShaper));
+    hb_font_funcs_t* funcs;
+    hb_font_t* parent;
+    if (shaper == NULL) return NULL;
+
+    // hb-ft maps the characters to glyphs, the sub font positions them in font units with the advances of
+    // fons__hbGlyphAdvance, fons__hbStoreGlyphs scales them to the exact size of the text.
+    shaper->face = face;
+    parent = hb_ft_font_create(face, NULL);
+    shaper->font = hb_font_create_sub_font(parent);
+    hb_font_destroy(parent);
+    funcs = hb_font_funcs_create();
+    hb_font_funcs_set_glyph_h_advance_func(funcs, fons__hbGlyphAdvance, NULL, NULL);
+    hb_font_set_funcs(shaper->font, funcs, face, NULL);
+    hb_font_funcs_destroy(funcs);
+    shaper->buffer = hb_buffer_create();
+
+    return shaper;
+}
+
+static void fons__hbClearPlans(FONShbFontShaper* shaper)
+{
+    int i;
+    for (i = 0; i < shaper->nplans; i++)
+        hb_shape_plan_destroy(shaper->plans[i].plan);
+    shaper->nplans = 0;
+}
+
+static void fons__hbDeleteShaper(FONShbFontShaper* shaper)
+{
+    fons__hbClearPlans(shaper);
+    hb_buffer_destroy(shaper->buffer);
+    hb_font_destroy(shaper->font);
+    free(shaper);
+}
+
+int fons__tt_initShaper(FONSttFontImpl* font)
+{
+    FONShbFontShaper* shaper = fons__hbCreateShaper(font->font);
+
+    font->shaper = shaper;
+
+    return shaper != NULL && hb_buffer_allocation_successful(shaper->buffer);
+}
+
+void fons__tt_freeShaper(FONSttFontImpl* font)
+{
+    FONShbFontShaper* shaper = (FONShbFontShaper*)font->shaper;
+    if(shaper) {
+#ifdef FONS_USE_THREADS
+        int i;
+        for (i = 1; i < FONS_MAX_THREADS; i++) {
+            if (shaper->workers[i]) {
+                FT_Face face = shaper->workers[i]->face;
+                fons__hbDeleteShaper(shaper->workers[i]);
+                FT_Done_Face(face);
+            }
+        }
+#endif
+        fons__hbDeleteShaper(shaper);
+    }
+}
+
+// Returns the shape plan of the buffer segment properties and a feature set, hb_shape looks it up in
+// the face for every call otherwise.
+static hb_shape_plan_t* fons__hbGetPlan(FONShbFontShaper* shaper, const hb_segment_properties_t* props,
+                                        int featureSet, const FONSfeatureSet* features)
+{
+    FONShbPlan* plan;
+    int i, lru = 0;
+
+    for (i = 0; i < shaper->nplans; i++) {
+        plan = &shaper->plans[i];
+        if (plan->featureSet == featureSet && hb_segment_properties_equal(&plan->props, props)) {
+            plan->lastUse = ++shaper->clock;
+            return plan->plan;
+        }
+        if (plan->lastUse < shaper->plans[lru].lastUse)
+            lru = i;
+    }
+
+    if (shaper->nplans < FONS_SHAPE_PLANS) {
+        plan = &shaper->plans[shaper->nplans++];
+    } else {
+        plan = &shaper->plans[lru];
+        hb_shape_plan_destroy(plan->plan);
+    }
+    plan->props = *props;
+    plan->featureSet = featureSet;
+    plan->plan = hb_shape_plan_create_cached(hb_font_get_face(shaper->font), props,
+                                             features->features, features->nfeatures, NULL);
+    plan->lastUse = ++shaper->clock;
+    return plan->plan;
+}
+
+// Shapes the bytes [offset, offset+length) of len bytes of text with the segment properties of the context, the
+// others are context and give their guessed properties to the part. The glyphs are left in the shaper buffer.
+static unsigned int fons__hbShapeText(FONShbFontShaper* shaper, const FONSshaping* shaping,
+                                      const char* text, int len, int offset, int length, short isize)
+{
+    hb_buffer_t* buffer = shaper->buffer;
+    const FONSfeatureSet* features = &shaping->featureSets[shaping->featureSet];
+    hb_segment_properties_t props;
+    int px = fons__maxi(isize / 10, 1), upem = shaper->face->units_per_EM;
+
+    // The hb-ft parent works at the pixel size of the face, which it doesn't read back by itself.
+    FT_Set_Pixel_Sizes(shaper->face, 0, px);
+    hb_font_set_scale(hb_font_get_parent(shaper->font), px * 64, px * 64);
+    hb_font_set_scale(shaper->font, upem, upem);
+    hb_font_set_ppem(shaper->font, px, px);
+    shaper->scale = fons__hbScale(isize);
+
+    hb_buffer_reset(buffer);
+    hb_buffer_add_utf8(buffer, text, len, 0, len);
+
+    if (shaping->customConfig) {
+        hb_buffer_set_direction(buffer, shaping->direction);
+        hb_buffer_set_script(buffer, shaping->script);
+        hb_buffer_set_language(buffer, shaping->language);
     } else {
         hb_buffer_guess_segment_properties(buffer);
     }
 
-    hb_shape(ft, buffer, NULL, 0);
+    hb_buffer_get_segment_properties(buffer, &props);
+    if (offset != 0 || length != len) {
+        hb_buffer_clear_contents(buffer);
+        hb_buffer_add_utf8(buffer, text, len, offset, length);
+        hb_buffer_set_segment_properties(buffer, &props);
+    }
+    hb_shape_plan_execute(fons__hbGetPlan(shaper, &props, shaping->featureSet, features), shaper->font, buffer,
+                          features->features, features->nfeatures);
 
-    hb_glyph_info_t *glyphInfo = hb_buffer_get_glyph_infos(buffer, &res->glyphCount);
-    hb_glyph_position_t *glyphPos = hb_buffer_get_glyph_positions(buffer, &res->glyphCount);
+    return hb_buffer_get_length(buffer);
+}
 
-    res->codepoints = (uint32_t *) malloc(sizeof(uint32_t) * res->glyphCount);
+// Copies the glyphs left in the shaper buffer to a result sized for them, scaled to 26.6 units.
+static void fons__hbStoreGlyphs(FONShbFontShaper* shaper, FONSshapingRes* res)
+{
+    unsigned int i, j, glyphCount;
+    int scale = shaper->scale, upem = shaper->face->units_per_EM;
 
-    res->offset = (float *) malloc(sizeof(float) * res->glyphCount * 2);
-    res->advance = (float *) malloc(sizeof(float) * res->glyphCount * 2);
+    hb_glyph_info_t *glyphInfo = hb_buffer_get_glyph_infos(shaper->buffer, &glyphCount);
+    hb_glyph_position_t *glyphPos = hb_buffer_get_glyph_positions(shaper->buffer, &glyphCount);
 
-    for(i = 0, j = 0; i < res->glyphCount; i++, j+=2) {
-        res->advance[j] = glyphPos[i].x_advance;
-        res->advance[j+1] = glyphPos[i].y_advance;
-        res->offset[j] = glyphPos[i].x_offset;
-        res->offset[j+1] = glyphPos[i].y_offset;
+    for(i = 0, j = 0; i < glyphCount; i++, j+=2) {
+        res->advance[j] = (float)fons__hbScaleUnits(glyphPos[i].x_advance, scale, upem);
+        res->advance[j+1] = (float)fons__hbScaleUnits(glyphPos[i].y_advance, scale, upem);
+        res->offset[j] = (float)fons__hbScaleUnits(glyphPos[i].x_offset, scale, upem);
+        res->offset[j+1] = (float)fons__hbScaleUnits(glyphPos[i].y_offset, scale, upem);
         res->codepoints[i] = glyphInfo[i].codepoint;
+        res->clusters[i] = glyphInfo[i].cluster;
+    }
+}
+
+static unsigned int fons__hashShaping(const char* text, int len, short isize)
+{
+    unsigned int h = 2166136261u;
+    int i;
+    for (i = 0; i < len; i++) {
+        h ^= (unsigned char)text[i];
+        h *= 16777619u;
+    }
+    return h ^ fons__hashint((unsigned int)isize);
+}
+
+static int fons__cmpShapingUse(const void* a, const void* b)
+{
+    unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// Drops the least recently used entries, at least a quarter of the entries and of the arena beyond
+// the count bytes needed, so that the next misses add without evicting. The remaining data then
+// slides to the start of the arena and the lookup is rebuilt once for the whole batch.
+static void fons__shapingCacheEvict(FONSshapingCache* cache, int count)
+{
+    unsigned long long order[FONS_SHAPING_CACHE_SIZE];
+    int maxEntries = FONS_SHAPING_CACHE_SIZE - fons__maxi(FONS_SHAPING_CACHE_SIZE/4, 1);
+    int maxBytes = fons__maxi(FONS_SHAPING_CACHE_BYTES - FONS_SHAPING_CACHE_BYTES/4 - count, 0);
+    int i, n, used = 0, h;
+
+    // Oldest first, the entry index in the low bits.
+    for (i = 0; i < cache->nentries; i++) {
+        used += cache->entries[i].size;
+        order[i] = ((unsigned long long)cache->entries[i].lastUse << 32) | (unsigned int)i;
+    }
+    qsort(order, cache->nentries, sizeof(order[0]), fons__cmpShapingUse);
+
+    n = cache->nentries;
+    for (i = 0; i < cache->nentries && (n > maxEntries || used > maxBytes); i++, n--) {
+        FONSshapingEntry* entry = &cache->entries[order[i] & 0xffffffffu];
+        used -= entry->size;
+        entry->size = -1;
+    }
+
+    cache->narena = 0;
+    for (i = 0; i < FONS_HASH_LUT_SIZE; i++)
+        cache->lut[i] = -1;
+    for (i = 0, n = 0; i < cache->nentries; i++) {
+        FONSshapingEntry* entry = &cache->entries[n];
+        if (cache->entries[i].size < 0) continue;
+        if (n != i)
+            *entry = cache->entries[i];
+        if (entry->data != cache->narena) {
+            memmove(&cache->arena[cache->narena], &cache->arena[entry->data], entry->size);
+            entry->data = cache->narena;
+        }
+        cache->narena += entry->size;
+        h = entry->hash & (FONS_HASH_LUT_SIZE-1);
+        entry->next = cache->lut[h];
+        cache->lut[h] = n++;
+    }
+    cache->nentries = n;
+}
+
+// Points res at the cached result of a string shaped with the context segment properties.
+static int fons__shapingCacheFind(FONSshaping* shaping, FONSfont* font, const char* text, int len, short isize,
+                                  unsigned int hash, FONSshapingRes* res)
+{
+    FONSshapingCache* cache = &shaping->cache;
+    FONSshapingEntry* entry;
+    unsigned char* data;
+    int e;
+
+    for (e = cache->lut[hash & (FONS_HASH_LUT_SIZE-1)]; e != -1; e = entry->next) {
+        entry = &cache->entries[e];
+        if (entry->hash != hash || entry->font != font || entry->isize != isize || entry->textLength != len
+                || entry->customConfig != shaping->customConfig || entry->featureSet != shaping->featureSet)
+            continue;
+        if (shaping->customConfig && (entry->script != shaping->script
+                || entry->direction != shaping->direction || entry->language != shaping->language))
+            continue;
+        data = &cache->arena[entry->data];
+        if (memcmp(data + entry->size - ((len + 3) & ~3), text, len) != 0)
+            continue;
+        entry->lastUse = ++cache->clock;
+        fons__shapingView(res, data, entry->glyphCount);
+        res->simple = entry->simple;
+        return 1;
+    }
+    return 0;
+}
+
+// Makes room for glyphCount glyphs of a string in the cache and copies the text, strings too long
+// for the arena go to the large buffer. Returns 0 when out of memory.
+static int fons__shapingCacheAdd(FONSshaping* shaping, FONSfont* font, const char* text, int len, short isize,
+                                 unsigned int hash, unsigned int glyphCount, int simple, FONSshapingRes* res)
+{
+    FONSshapingCache* cache = &shaping->cache;
+    FONSshapingEntry* entry;
+    unsigned char* data;
+    int size, h = hash & (FONS_HASH_LUT_SIZE-1);
+
+    size = (int)fons__runGlyphBytes(glyphCount) + ((len + 3) & ~3);
+
+    if (cache->arena == NULL)
+        cache->arena = (unsigned char*) malloc(FONS_SHAPING_CACHE_BYTES);
+
+    if (size <= FONS_SHAPING_CACHE_BYTES && cache->arena != NULL) {
+        if (cache->nentries >= FONS_SHAPING_CACHE_SIZE || cache->narena + size > FONS_SHAPING_CACHE_BYTES)
+            fons__shapingCacheEvict(cache, size);
+
+        entry = &cache->entries[cache->nentries];
+        entry->hash = hash;
+        entry->font = font;
+        entry->isize = isize;
+        entry->customConfig = shaping->customConfig;
+        entry->script = shaping->script;
+        entry->direction = shaping->direction;
+        entry->language = shaping->language;
+        entry->featureSet = shaping->featureSet;
+        entry->textLength = len;
+        entry->glyphCount = glyphCount;
+        entry->simple = simple;
+        entry->data = cache->narena;
+        entry->size = size;
+        entry->lastUse = ++cache->clock;
+        entry->next = cache->lut[h];
+        cache->lut[h] = cache->nentries++;
+        data = &cache->arena[cache->narena];
+        cache->narena += size;
+    } else {
+        if (cache->clarge < size) {
+            unsigned char* large = (unsigned char*) realloc(cache->large, size);
+            if (large == NULL) return 0;
+            cache->large = large;
+            cache->clarge = size;
+        }
+        data = cache->large;
+    }
+
+    fons__shapingView(res, data, glyphCount);
+    res->simple = simple;
+    memcpy(data + size - ((len + 3) & ~3), text, len);
+    return 1;
+}
+
+int fons__hb_shape(FONScontext* stash, const char* text, const char* end, FONSfont* font, short isize,
+                   FONSshapingRes* res)
+{
+    FONSshaping* shaping = stash->shaping;
+    FONShbFontShaper* shaper = (FONShbFontShaper *) font->font.shaper;
+    unsigned int hash, glyphCount;
+    int len;
+
+    len = end ? (int)(end - text) : (int)strlen(text);
+    hash = fons__hashShaping(text, len, isize);
+
+    if (fons__shapingCacheFind(shaping, font, text, len, isize, hash, res)) {
+        shaping->cache.hits++;
+        return 1;
+    }
+    shaping->cache.misses++;
+
+    // Strings that only need the cmap and kerning skip HarfBuzz.
+    glyphCount = fons__simpleRun(shaping, font, text, len);
+    if (glyphCount > 0) {
+        if (!fons__shapingCacheAdd(shaping, font, text, len, isize, hash, glyphCount, 1, res))
+            return 0;
+        fons__simpleShape(font, shaper->face, text, len, 0, len, isize, res);
+        return 1;
     }
+
+    glyphCount = fons__hbShapeText(shaper, shaping, text, len, 0, len, isize);
+    if (!fons__shapingCacheAdd(shaping, font, text, len, isize, hash, glyphCount, 0, res))
+        return 0;
+    fons__hbStoreGlyphs(shaper, res);
+    return 1;
 }
 
 void fons__hb_freeShapingResult(FONSshaping* shaping)
 {
     if(shaping) {
         shaping->customConfig = false;
-        free(shaping->result->advance);
-        free(shaping->result->offset);
-        free(shaping->result->codepoints);
-        free(shaping->result);
+        shaping->result = NULL;
+    }
+}
+
+void fons__hb_initShapingCache(FONSshaping* shaping)
+{
+    FONSshapingCache* cache = &shaping->cache;
+    int i;
+    cache->nentries = 0;
+    cache->narena = 0;
+    for (i = 0; i < FONS_HASH_LUT_SIZE; i++)
+        cache->lut[i] = -1;
+    // Set 0 is the font defaults.
+    shaping->nfeatureSets = 1;
+    shaping->featureSet = 0;
+}
+
+// Selects a feature set, reusing the index of an identical one. When all are taken the results
+// and plans made with the previous sets are dropped before the indices start over.
+void fons__hb_setFeatures(FONScontext* stash, const char* str)
+{
+    FONSshaping* shaping = stash->shaping;
+    FONSfeatureSet set;
+    const char* end;
+    int i;
+
+    memset(&set, 0, sizeof(set));
+    for (; str != NULL && *str; str = *end ? end + 1 : end) {
+        end = strchr(str, ',');
+        if (end == NULL) end = str + strlen(str);
+        if (set.nfeatures < FONS_SHAPING_FEATURES && hb_feature_from_string(str, (int)(end - str), &set.features[set.nfeatures]))
+            set.nfeatures++;
+    }
+
+    for (i = 0; i < shaping->nfeatureSets; i++) {
+        if (memcmp(&shaping->featureSets[i], &set, sizeof(set)) == 0) {
+            shaping->featureSet = i;
+            return;
+        }
     }
+
+    if (shaping->nfeatureSets == FONS_SHAPING_FEATURE_SETS) {
+        fons__hb_initShapingCache(shaping);
+        for (i = 0; i < stash->nfonts; i++) {
+            FONShbFontShaper* shaper = (FONShbFontShaper*)stash->fonts[i]->font.shaper;
+            if (shaper == NULL) continue;
+            fons__hbClearPlans(shaper);
+#ifdef FONS_USE_THREADS
+            for (int j = 1; j < FONS_MAX_THREADS; j++) {
+                if (shaper->workers[j])
+                    fons__hbClearPlans(shaper->workers[j]);
+            }
+#endif
+        }
+    }
+    shaping->featureSets[shaping->nfeatureSets] = set;
+    shaping->featureSet = shaping->nfeatureSets++;
+}
+
+void fons__hb_freeShapingCache(FONSshaping* shaping)
+{
+    free(shaping->cache.arena);
+    free(shaping->cache.large);
 }
 
 #else
 
-void fons__hb_shape(FONScontext* stash, const char* text, FONSfont* font)
+int fons__hb_shape(FONScontext* stash, const char* text, const char* end, FONSfont* font, short isize,
+                   FONSshapingRes* res)
 {
     FONS_NOTUSED(stash);
     FONS_NOTUSED(text);
+    FONS_NOTUSED(end);
+    FONS_NOTUSED(font);
+    FONS_NOTUSED(isize);
+    FONS_NOTUSED(res);
+    return 0;
 }
 
 void fons__hb_freeShapingResult(FONSshaping* shaping)
@@ -643,6 +1833,22 @@ void fons__hb_freeShapingResult(FONSshaping* shaping)
     FONS_NOTUSED(shaping);
 }
 
+void fons__hb_initShapingCache(FONSshaping* shaping)
+{
+    FONS_NOTUSED(shaping);
+}
+
+void fons__hb_setFeatures(FONScontext* stash, const char* str)
+{
+    FONS_NOTUSED(stash);
+    FONS_NOTUSED(str);
+}
+
+void fons__hb_freeShapingCache(FONSshaping* shaping)
+{
+    FONS_NOTUSED(shaping);
+}
+
 int fons__tt_initShaper(FONSttFontImpl* font)
 {
     font->shaper = NULL;
@@ -924,16 +2130,41 @@ static void fons__addWhiteRect(FONScontext* stash, int w, int h)
     stash->dirtyRect[3] = fons__maxi(stash->dirtyRect[3], gy+h);
 }
 
+static int fons__allocPageRGB(FONScontext* stash)
+{
+    int size = stash->params.width * stash->params.height * 3;
+    if (stash->texDataRGB != NULL) return 1;
+
+    stash->atlasRGB = fons__allocAtlas(stash->params.width, stash->params.height, FONS_INIT_ATLAS_NODES);
+    if (stash->atlasRGB == NULL) return 0;
+    stash->texDataRGB = (unsigned char*)malloc(size);
+    if (stash->texDataRGB == NULL) {
+        fons__deleteAtlas(stash->atlasRGB);
+        stash->atlasRGB = NULL;
+        return 0;
+    }
+    memset(stash->texDataRGB, 0, size);
+
+    stash->dirtyRectRGB[0] = stash->params.width;
+    stash->dirtyRectRGB[1] = stash->params.height;
+    stash->dirtyRectRGB[2] = 0;
+    stash->dirtyRectRGB[3] = 0;
+    return 1;
+}
+
 void fons__allocShaping(FONScontext* stash)
 {
     FONSshaping* shaping = (FONSshaping *) malloc(sizeof(FONSshaping));
     stash->shaping = shaping;
-    stash->shaping->it = -1;
+    if (shaping == NULL) return;
+    memset(shaping, 0, sizeof(FONSshaping));
+    fons__hb_initShapingCache(shaping);
 }
 
 void fons__deleteShaping(FONScontext* stash)
 {
     if(stash->shaping) {
+        fons__hb_freeShapingCache(stash->shaping);
         free(stash->shaping);
     }
 }
@@ -948,6 +2179,9 @@ FONScontext* fonsCreateInternal(FONSparams* params)
     memset(stash, 0, sizeof(FONScontext));
 
     stash->params = *params;
+    stash->sdfDownsample = 1;
+    stash->sdfEngine = FONS_SDF_DEFAULT_ENGINE;
+    fons__initKernels(&stash->kernels);
 
     // Allocate scratch buffer.
     stash->scratch = (unsigned char*)malloc(FONS_SCRATCH_BUF_SIZE);
@@ -1041,7 +2275,6 @@ void fonsSetFont(FONScontext* stash, int font)
 void fons__clearShaping(FONScontext* stash)
 {
     fons__hb_freeShapingResult(stash->shaping);
-    stash->shaping->it = -1;
     fons__getState(stash)->useShaping = 0;
 }
 
@@ -1084,6 +2317,10 @@ static void fons__freeFont(FONSfont* font)
 {
     if (font == NULL) return;
     if (font->glyphs) free(font->glyphs);
+    fons__freeOutlineCache(&font->outlines);
+    if (font->kerning.dense) free(font->kerning.dense);
+    if (font->kerning.keys) free(font->kerning.keys);
+    if (font->kerning.values) free(font->kerning.values);
     if (font->freeData && font->data) free(font->data);
     fons__tt_freeShaper(&font->font);
     free(font);
@@ -1172,6 +2409,8 @@ int fonsAddFontMem(FONScontext* stash, const char* name, unsigned char* data, in
     // Init hash lookup.
     for (i = 0; i < FONS_HASH_LUT_SIZE; ++i)
         font->lut[i] = -1;
+    for (i = 0; i < FONS_HASH_LUT_SIZE; ++i)
+        font->outlines.lut[i] = -1;
 
     // Read in the font data.
     font->dataSize = dataSize;
@@ -1181,6 +2420,7 @@ int fonsAddFontMem(FONScontext* stash, const char* name, unsigned char* data, in
     // Init font
     stash->nscratch = 0;
     if (!fons__tt_loadFont(stash, &font->font, data, dataSize)) goto error;
+    if (!fons__buildKerning(&font->kerning, &font->font)) goto error;
 
     // Store normalized line height. The real line height is got
     // by multiplying the lineh by font size.
@@ -1221,121 +2461,1245 @@ static FONSglyph* fons__allocGlyph(FONSfont* font)
 }
 
 
-// Based on Exponential blur, Jani Huhtanen, 2006
+// Outline flattening
 
-#define APREC 16
-#define ZPREC 7
+static int fons__outlineAddPoint(FONSoutline* outline, float x, float y, int smooth)
+{
+    if (outline->npts+1 > outline->cpts) {
+        int cpts = outline->cpts == 0 ? 256 : outline->cpts * 2;
+        float* pts = (float*)realloc(outline->pts, sizeof(float) * 2 * cpts);
+        unsigned char* flags;
+        if (pts == NULL) goto error;
+        outline->pts = pts;
+        flags = (unsigned char*)realloc(outline->smooth, cpts);
+        if (flags == NULL) goto error;
+        outline->smooth = flags;
+        outline->cpts = cpts;
+    }
+    outline->pts[outline->npts*2+0] = x;
+    outline->pts[outline->npts*2+1] = y;
+    outline->smooth[outline->npts] = (unsigned char)smooth;
+    outline->npts++;
+    return 1;
 
-static void fons__blurCols(unsigned char* dst, int w, int h, int dstStride, int alpha)
+error:
+    outline->nomem = 1;
+    return 0;
+}
+
+static void fons__outlineReset(FONSoutline* outline, float tol)
 {
-    int x, y;
-    for (y = 0; y < h; y++) {
-        int z = 0; // force zero border
-        for (x = 1; x < w; x++) {
-            z += (alpha * (((int)(dst[x]) << ZPREC) - z)) >> APREC;
-            dst[x] = (unsigned char)(z >> ZPREC);
-        }
-        dst[w-1] = 0; // force zero border
-        z = 0;
-        for (x = w-2; x >= 0; x--) {
-            z += (alpha * (((int)(dst[x]) << ZPREC) - z)) >> APREC;
-            dst[x] = (unsigned char)(z >> ZPREC);
+    outline->npts = 0;
+    outline->ncontours = 0;
+    outline->start = 0;
+    outline->nomem = 0;
+    outline->tol = tol;
+}
+
+static void fons__outlineClose(FONSoutline* outline)
+{
+    int n = outline->npts - outline->start;
+    float* first = &outline->pts[outline->start*2];
+
+    // Drop the closing point if it duplicates the first one.
+    if (n > 1 && outline->pts[(outline->npts-1)*2+0] == first[0] && outline->pts[(outline->npts-1)*2+1] == first[1]) {
+        outline->npts--;
+        n--;
+    }
+    // Contours with less than 3 points have no area.
+    if (n < 3) {
+        outline->npts = outline->start;
+        return;
+    }
+    if (outline->ncontours+1 > outline->ccontours) {
+        int ccontours = outline->ccontours == 0 ? 8 : outline->ccontours * 2;
+        int* contours = (int*)realloc(outline->contours, sizeof(int) * ccontours);
+        if (contours == NULL) {
+            outline->nomem = 1;
+            return;
         }
-        dst[0] = 0; // force zero border
-        dst += dstStride;
+        outline->contours = contours;
+        outline->ccontours = ccontours;
     }
+    outline->contours[outline->ncontours++] = n;
+    outline->start = outline->npts;
 }
 
-static void fons__blurRows(unsigned char* dst, int w, int h, int dstStride, int alpha)
+static void fons__outlineMoveTo(FONSoutline* outline, float x, float y)
 {
-    int x, y;
-    for (x = 0; x < w; x++) {
-        int z = 0; // force zero border
-        for (y = dstStride; y < h*dstStride; y += dstStride) {
-            z += (alpha * (((int)(dst[y]) << ZPREC) - z)) >> APREC;
-            dst[y] = (unsigned char)(z >> ZPREC);
-        }
-        dst[(h-1)*dstStride] = 0; // force zero border
-        z = 0;
-        for (y = (h-2)*dstStride; y >= 0; y -= dstStride) {
-            z += (alpha * (((int)(dst[y]) << ZPREC) - z)) >> APREC;
-            dst[y] = (unsigned char)(z >> ZPREC);
-        }
-        dst[0] = 0; // force zero border
-        dst++;
+    fons__outlineClose(outline);
+    fons__outlineAddPoint(outline, x, y, 0);
+}
+
+static void fons__outlineLineTo(FONSoutline* outline, float x, float y)
+{
+    if (outline->npts > outline->start) {
+        float* last = &outline->pts[(outline->npts-1)*2];
+        if (last[0] == x && last[1] == y) return;
     }
+    fons__outlineAddPoint(outline, x, y, 0);
 }
 
+static int fons__outlineSteps(float dd, float tol)
+{
+    // Uniform subdivision, chord error is bounded by dd / (8*n*n).
+    int n = (int)ceilf(sqrtf(dd / (8.0f * tol)));
+    return n < 1 ? 1 : (n > 32 ? 32 : n);
+}
 
-static void fons__blur(FONScontext* stash, unsigned char* dst, int w, int h, int dstStride, int blur)
+static void fons__outlineQuadTo(FONSoutline* outline, float cx, float cy, float x, float y)
 {
-    int alpha;
-    float sigma;
-    (void)stash;
+    float x0, y0, ddx, ddy;
+    int i, n;
+    if (outline->npts <= outline->start) return;
+    x0 = outline->pts[(outline->npts-1)*2+0];
+    y0 = outline->pts[(outline->npts-1)*2+1];
+    ddx = 2.0f * (x0 - 2.0f*cx + x);
+    ddy = 2.0f * (y0 - 2.0f*cy + y);
+    n = fons__outlineSteps(sqrtf(ddx*ddx + ddy*ddy), outline->tol);
+    for (i = 1; i < n; i++) {
+        float t = (float)i / n, mt = 1.0f - t;
+        fons__outlineAddPoint(outline, mt*mt*x0 + 2.0f*mt*t*cx + t*t*x,
+                              mt*mt*y0 + 2.0f*mt*t*cy + t*t*y, 1);
+    }
+    fons__outlineLineTo(outline, x, y);
+}
 
-    if (blur < 1)
-        return;
-    // Calculate the alpha such that 90% of the kernel is within the radius. (Kernel extends to infinity)
-    sigma = (float)blur * 0.57735f; // 1 / sqrt(3)
-    alpha = (int)((1<<APREC) * (1.0f - expf(-2.3f / (sigma+1.0f))));
-    fons__blurRows(dst, w, h, dstStride, alpha);
-    fons__blurCols(dst, w, h, dstStride, alpha);
-    fons__blurRows(dst, w, h, dstStride, alpha);
-    fons__blurCols(dst, w, h, dstStride, alpha);
-    //	fons__blurrows(dst, w, h, dstStride, alpha);
-    //	fons__blurcols(dst, w, h, dstStride, alpha);
+// Only FreeType outlines have cubic segments.
+#ifdef FONS_USE_FREETYPE
+static void fons__outlineCubicTo(FONSoutline* outline, float c1x, float c1y, float c2x, float c2y, float x, float y)
+{
+    float x0, y0, ddx0, ddy0, ddx1, ddy1, dd;
+    int i, n;
+    if (outline->npts <= outline->start) return;
+    x0 = outline->pts[(outline->npts-1)*2+0];
+    y0 = outline->pts[(outline->npts-1)*2+1];
+    ddx0 = x0 - 2.0f*c1x + c2x;
+    ddy0 = y0 - 2.0f*c1y + c2y;
+    ddx1 = c1x - 2.0f*c2x + x;
+    ddy1 = c1y - 2.0f*c2y + y;
+    dd = 6.0f * sqrtf(fons__maxf(ddx0*ddx0 + ddy0*ddy0, ddx1*ddx1 + ddy1*ddy1));
+    n = fons__outlineSteps(dd, outline->tol);
+    for (i = 1; i < n; i++) {
+        float t = (float)i / n, mt = 1.0f - t;
+        float a = mt*mt*mt, b = 3.0f*mt*mt*t, c = 3.0f*mt*t*t, d = t*t*t;
+        fons__outlineAddPoint(outline, a*x0 + b*c1x + c*c2x + d*x, a*y0 + b*c1y + c*c2y + d*y, 1);
+    }
+    fons__outlineLineTo(outline, x, y);
 }
+#endif
 
-static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned int codepoint,
-                                 short isize, short iblur, int blurType)
+static int fons__outlineBytes(int nglyphs, int npts, int ncontours)
 {
-    int i, g, advance, lsb, x0, y0, x1, y1, gw, gh, gx, gy, x, y;
-    float scale;
-    FONSglyph* glyph = NULL;
-    unsigned int h;
-    float size = isize/10.0f;
-    int pad, added;
-    unsigned char* bdst;
-    unsigned char* dst;
+    return nglyphs * (int)sizeof(FONSoutlineGlyph) + npts * (int)(sizeof(float) * 2 + 1) + ncontours * (int)sizeof(int);
+}
 
-    if (isize < 2) return NULL;
-    if (iblur > 20) iblur = 20;
-    pad = iblur+2;
+// Forgets all outlines, the arrays are kept for the next ones.
+static void fons__clearOutlineCache(FONSoutlineCache* cache)
+{
+    int i;
+    cache->nglyphs = 0;
+    cache->npts = 0;
+    cache->ncontours = 0;
+    for (i = 0; i < FONS_HASH_LUT_SIZE; i++)
+        cache->lut[i] = -1;
+}
 
-    // Reset allocator.
-    stash->nscratch = 0;
+static void fons__freeOutlineCache(FONSoutlineCache* cache)
+{
+    if (cache->glyphs) free(cache->glyphs);
+    if (cache->pts) free(cache->pts);
+    if (cache->smooth) free(cache->smooth);
+    if (cache->contours) free(cache->contours);
+    cache->glyphs = NULL;
+    cache->pts = NULL;
+    cache->smooth = NULL;
+    cache->contours = NULL;
+    cache->cglyphs = 0;
+    cache->cpts = 0;
+    cache->ccontours = 0;
+    fons__clearOutlineCache(cache);
+}
 
-    // Find code point and size.
-    h = fons__hashint(codepoint) & (FONS_HASH_LUT_SIZE-1);
-    i = font->lut[h];
-    while (i != -1) {
-        if (font->glyphs[i].codepoint == codepoint && font->glyphs[i].size == isize
-                && font->glyphs[i].blur == iblur && font->glyphs[i].blurType == blurType)
-            return &font->glyphs[i];
-        i = font->glyphs[i].next;
+static int fons__cacheOutline(FONSoutlineCache* cache, const FONSoutline* outline, int glyph, int advance)
+{
+    FONSoutlineGlyph* entry;
+    int i, h;
+
+    // Start over when the outline would take the cache over its size, the arrays then stay within twice of it.
+    if (fons__outlineBytes(cache->nglyphs + 1, cache->npts + outline->npts, cache->ncontours + outline->ncontours) > FONS_OUTLINE_CACHE_SIZE)
+        fons__clearOutlineCache(cache);
+
+    if (cache->nglyphs+1 > cache->cglyphs) {
+        int cglyphs = cache->cglyphs == 0 ? 64 : cache->cglyphs * 2;
+        FONSoutlineGlyph* glyphs = (FONSoutlineGlyph*)realloc(cache->glyphs, sizeof(FONSoutlineGlyph) * cglyphs);
+        if (glyphs == NULL) return -1;
+        cache->glyphs = glyphs;
+        cache->cglyphs = cglyphs;
     }
-
-    // Could not find glyph, create it.
-    scale = fons__tt_getPixelHeightScale(&font->font, size);
-    g = fons__tt_getGlyphIndex(&font->font, codepoint, fons__getState(stash)->useShaping
-            && font->font.shaper != NULL);
-    if (g == 0) {
-        return NULL;
+    if (cache->npts + outline->npts > cache->cpts) {
+        int cpts = fons__maxi(cache->cpts == 0 ? 4096 : cache->cpts * 2, cache->npts + outline->npts);
+        float* pts = (float*)realloc(cache->pts, sizeof(float) * 2 * cpts);
+        unsigned char* smooth;
+        if (pts == NULL) return -1;
+        cache->pts = pts;
+        smooth = (unsigned char*)realloc(cache->smooth, cpts);
+        if (smooth == NULL) return -1;
+        cache->smooth = smooth;
+        cache->cpts = cpts;
+    }
+    if (cache->ncontours + outline->ncontours > cache->ccontours) {
+        int ccontours = fons__maxi(cache->ccontours == 0 ? 256 : cache->ccontours * 2, cache->ncontours + outline->ncontours);
+        int* contours = (int*)realloc(cache->contours, sizeof(int) * ccontours);
+        if (contours == NULL) return -1;
+        cache->contours = contours;
+        cache->ccontours = ccontours;
     }
-    fons__tt_buildGlyphBitmap(&font->font, g, size, scale, &advance, &lsb, &x0, &y0, &x1, &y1);
-    gw = x1-x0 + pad*2;
-    gh = y1-y0 + pad*2;
 
-    // Find free spot for the rect in the atlas
-    added = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy);
-    if (added == 0 && stash->handleError != NULL) {
-        // Atlas is full, let the user to resize the atlas (or not), and try again.
-        stash->handleError(stash->errorUptr, FONS_ATLAS_FULL, 0);
-        added = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy);
+    entry = &cache->glyphs[cache->nglyphs];
+    entry->glyph = glyph;
+    entry->advance = advance;
+    entry->pts = cache->npts;
+    entry->npts = outline->npts;
+    entry->contours = cache->ncontours;
+    entry->ncontours = outline->ncontours;
+    memcpy(&cache->pts[cache->npts*2], outline->pts, sizeof(float) * 2 * outline->npts);
+    memcpy(&cache->smooth[cache->npts], outline->smooth, outline->npts);
+    memcpy(&cache->contours[cache->ncontours], outline->contours, sizeof(int) * outline->ncontours);
+    cache->npts += outline->npts;
+    cache->ncontours += outline->ncontours;
+
+    entry->bounds[0] = entry->bounds[1] = entry->bounds[2] = entry->bounds[3] = 0.0f;
+    for (i = 0; i < outline->npts; i++) {
+        float x = outline->pts[i*2+0], y = outline->pts[i*2+1];
+        if (i == 0 || x < entry->bounds[0]) entry->bounds[0] = x;
+        if (i == 0 || y < entry->bounds[1]) entry->bounds[1] = y;
+        if (i == 0 || x > entry->bounds[2]) entry->bounds[2] = x;
+        if (i == 0 || y > entry->bounds[3]) entry->bounds[3] = y;
     }
-    if (added == 0) return NULL;
 
-    // Init glyph.
+    h = fons__hashint(glyph) & (FONS_HASH_LUT_SIZE-1);
+    entry->next = cache->lut[h];
+    cache->lut[h] = cache->nglyphs;
+    return cache->nglyphs++;
+}
+
+// Returns the flattened outline of a glyph, decoding it only the first time it is requested.
+static int fons__getGlyphOutline(FONScontext* stash, FONSfont* font, int glyph, FONSglyphOutline* view)
+{
+    FONSoutlineCache* cache = &font->outlines;
+    FONSoutlineGlyph* entry;
+    int i = cache->lut[fons__hashint(glyph) & (FONS_HASH_LUT_SIZE-1)];
+
+    while (i != -1 && cache->glyphs[i].glyph != glyph)
+        i = cache->glyphs[i].next;
+
+    if (i == -1) {
+        FONSoutline* outline = &stash->outline;
+        float unitsPerEm = 1.0f / fons__tt_getPixelHeightScale(&font->font, 1.0f);
+
+        fons__outlineReset(outline, FONS_OUTLINE_TOLERANCE * unitsPerEm);
+        if (!fons__tt_getGlyphOutline(&font->font, glyph, outline) || outline->nomem)
+            return 0;
+        i = fons__cacheOutline(cache, outline, glyph, fons__tt_getGlyphAdvance(&font->font, glyph));
+        if (i == -1) return 0;
+    }
+
+    entry = &cache->glyphs[i];
+    view->pts = &cache->pts[entry->pts*2];
+    view->smooth = &cache->smooth[entry->pts];
+    view->contours = &cache->contours[entry->contours];
+    view->npts = entry->npts;
+    view->ncontours = entry->ncontours;
+    memcpy(view->bounds, entry->bounds, sizeof(view->bounds));
+    view->advance = entry->advance;
+    return 1;
+}
+
+static void fons__getOutlineBitmapBox(const FONSglyphOutline* outline, float scale, int* x0, int* y0, int* x1, int* y1)
+{
+    *x0 = (int)floorf(outline->bounds[0] * scale);
+    *y0 = (int)floorf(-outline->bounds[3] * scale);
+    *x1 = (int)ceilf(outline->bounds[2] * scale);
+    *y1 = (int)ceilf(-outline->bounds[1] * scale);
+}
+
+#ifdef FONS_USE_COVERAGE_RASTERIZER
+
+// Coverage rasterizer, accumulates the signed area each line covers in every cell,
+// a running sum over the cells then gives the winding coverage of each pixel.
+static void fons__accumulateLine(float* acc, int w, int h, float x0, float y0, float x1, float y1)
+{
+    float dir, dxdy, x, t;
+    int y, yend;
+
+    if (y0 == y1) return;
+    if (y0 < y1) {
+        dir = 1.0f;
+    } else {
+        dir = -1.0f;
+        t = x0; x0 = x1; x1 = t;
+        t = y0; y0 = y1; y1 = t;
+    }
+    dxdy = (x1 - x0) / (y1 - y0);
+    x = x0;
+    if (y0 < 0.0f) {
+        x -= y0 * dxdy;
+        y0 = 0.0f;
+    }
+    yend = fons__mini(h, (int)ceilf(y1));
+
+    for (y = (int)y0; y < yend; y++) {
+        float* row = &acc[y * w];
+        float dy = fons__minf((float)(y + 1), y1) - fons__maxf((float)y, y0);
+        float xnext = x + dxdy * dy;
+        float d = dy * dir;
+        float xa = fons__minf(x, xnext), xb = fons__maxf(x, xnext);
+        float xafloor, xbceil;
+        int xai, xbi;
+
+        xa = fons__maxf(0.0f, fons__minf(xa, (float)w));
+        xb = fons__maxf(0.0f, fons__minf(xb, (float)w));
+        xafloor = floorf(xa);
+        xbceil = ceilf(xb);
+        xai = (int)xafloor;
+        xbi = (int)xbceil;
+
+        if (xbi <= xai + 1) {
+            // Line stays inside one cell.
+            float xm = 0.5f * (xa + xb) - xafloor;
+            row[xai] += d - d * xm;
+            row[xai + 1] += d * xm;
+        } else {
+            float s = 1.0f / (xb - xa);
+            float xaf = xa - xafloor;
+            float a0 = 0.5f * s * (1.0f - xaf) * (1.0f - xaf);
+            float xbf = xb - xbceil + 1.0f;
+            float am = 0.5f * s * xbf * xbf;
+            row[xai] += d * a0;
+            if (xbi == xai + 2) {
+                row[xai + 1] += d * (1.0f - a0 - am);
+            } else {
+                float a1 = s * (1.5f - xaf);
+                float a2 = a1 + (float)(xbi - xai - 3) * s;
+                int xi;
+                row[xai + 1] += d * (a1 - a0);
+                for (xi = xai + 2; xi < xbi - 1; xi++)
+                    row[xi] += d * s;
+                row[xbi - 1] += d * (1.0f - a2 - am);
+            }
+            row[xbi] += d * am;
+        }
+        x = xnext;
+    }
+}
+
+static unsigned char fons__coverageByte(float sum)
+{
+    return (unsigned char)(fons__minf(fabsf(sum), 1.0f) * 255.0f + 0.5f);
+}
+
+// Prefix sums a row of cells into 8-bit coverage, returns the running sum carried to the next row.
+// Blocks of 4 cells are summed in the same order as in the vector versions, so that all of them round the same way.
+static float fons__accumulateRowScalar(const float* acc, unsigned char* dst, int w, float sum)
+{
+    int x = 0;
+    for (; x + 4 <= w; x += 4) {
+        const float* c = &acc[x];
+        float c01 = c[0] + c[1];
+        dst[x] = fons__coverageByte(c[0] + sum);
+        dst[x+1] = fons__coverageByte(c01 + sum);
+        dst[x+2] = fons__coverageByte(((c[1] + c[2]) + c[0]) + sum);
+        sum = ((c[2] + c[3]) + c01) + sum;
+        dst[x+3] = fons__coverageByte(sum);
+    }
+    for (; x < w; x++) {
+        sum += acc[x];
+        dst[x] = fons__coverageByte(sum);
+    }
+    return sum;
+}
+
+#if defined(FONS_SSE2)
+static float fons__accumulateRowSSE2(const float* acc, unsigned char* dst, int w, float sum)
+{
+    int x = 0;
+    __m128 offset = _mm_set1_ps(sum);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (; x + 4 <= w; x += 4) {
+        __m128 v = _mm_loadu_ps(&acc[x]);
+        __m128i c;
+        v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+        v = _mm_add_ps(v, _mm_shuffle_ps(_mm_setzero_ps(), v, 0x40));
+        v = _mm_add_ps(v, offset);
+        offset = _mm_shuffle_ps(v, v, 0xff);
+        c = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_andnot_ps(sign, v), one), scale), half));
+        c = _mm_packs_epi32(c, c);
+        c = _mm_packus_epi16(c, c);
+        *(int*)&dst[x] = _mm_cvtsi128_si32(c);
+    }
+    return fons__accumulateRowScalar(&acc[x], &dst[x], w - x, _mm_cvtss_f32(offset));
+}
+#elif defined(FONS_NEON)
+static float fons__accumulateRowNEON(const float* acc, unsigned char* dst, int w, float sum)
+{
+    int x = 0;
+    float32x4_t offset = vdupq_n_f32(sum);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    for (; x + 4 <= w; x += 4) {
+        float32x4_t v = vld1q_f32(&acc[x]);
+        uint16x4_t c16;
+        uint8x8_t c8;
+        v = vaddq_f32(v, vextq_f32(zero, v, 3));
+        v = vaddq_f32(v, vextq_f32(zero, v, 2));
+        v = vaddq_f32(v, offset);
+        offset = vdupq_n_f32(vgetq_lane_f32(v, 3));
+        c16 = vmovn_u32(vcvtq_u32_f32(vaddq_f32(vmulq_n_f32(vminq_f32(vabsq_f32(v), one), 255.0f), vdupq_n_f32(0.5f))));
+        c8 = vmovn_u16(vcombine_u16(c16, c16));
+        vst1_lane_u32((uint32_t*)&dst[x], vreinterpret_u32_u8(c8), 0);
+    }
+    return fons__accumulateRowScalar(&acc[x], &dst[x], w - x, vgetq_lane_f32(offset, 0));
+}
+#endif
+
+// Rasterizes a cached outline into 8-bit coverage, returns 0 if the glyph does not fit in the scratch buffer.
+static int fons__rasterizeOutline(FONScontext* stash, const FONSglyphOutline* outline, float scale, int ox, int oy,
+                                  unsigned char* dst, int w, int h, int dstStride)
+{
+    float* acc;
+    float sum = 0.0f;
+    int i, j, y, first = 0;
+    int size = (w * h + 4) * (int)sizeof(float);
+
+    if (outline->npts == 0 || w == 0 || h == 0) return 1;
+    if (stash->nscratch + size + 16 > FONS_SCRATCH_BUF_SIZE) return 0;
+    acc = (float*)fons__tmpalloc(size, stash);
+    if (acc == NULL) return 0;
+    memset(acc, 0, size);
+
+    for (i = 0; i < outline->ncontours; i++) {
+        const float* pts = &outline->pts[first*2];
+        int n = outline->contours[i];
+        for (j = 0; j < n; j++) {
+            const float* p0 = &pts[j*2];
+            const float* p1 = &pts[(j+1 < n ? j+1 : 0)*2];
+            fons__accumulateLine(acc, w, h, p0[0] * scale - ox, -p0[1] * scale - oy,
+                                 p1[0] * scale - ox, -p1[1] * scale - oy);
+        }
+        first += n;
+    }
+
+    // Cells past the right edge carry over to the next row, so the sum runs over the whole buffer.
+    for (y = 0; y < h; y++)
+        sum = stash->kernels.accumulateRow(&acc[y * w], &dst[y * dstStride], w, sum);
+
+    fons__tmpfree(acc, stash);
+    return 1;
+}
+
+#endif // FONS_USE_COVERAGE_RASTERIZER
+
+static void fons__buildGlyphMSDF(FONScontext* stash, const FONSglyphOutline* outline, float scale, int ox, int oy,
+                                 unsigned char* dst, int w, int h, int dstStride, float radius)
+{
+    float* pts;
+    unsigned char* temp;
+    int i;
+
+    pts = (float*)fons__tmpalloc(sizeof(float) * 2 * outline->npts, stash);
+    temp = (unsigned char*)fons__tmpalloc(outline->npts, stash);
+    if (pts == NULL || temp == NULL) return;
+
+    // Font units to glyph pixels, y down.
+    for (i = 0; i < outline->npts; i++) {
+        pts[i*2+0] = outline->pts[i*2+0] * scale - ox;
+        pts[i*2+1] = -outline->pts[i*2+1] * scale - oy;
+    }
+    sdfBuildMultiChannelDistanceFieldNoAlloc(dst, dstStride, radius, pts, outline->smooth,
+                                             outline->contours, outline->ncontours, w, h, temp);
+}
+
+// Based on Exponential blur, Jani Huhtanen, 2006
+
+#define APREC 16
+#define ZPREC 7
+
+static void fons__blurCols(unsigned char* dst, int w, int h, int dstStride, int alpha)
+{
+    int x, y;
+    for (y = 0; y < h; y++) {
+        int z = 0; // force zero border
+        for (x = 1; x < w; x++) {
+            z += (alpha * (((int)(dst[x]) << ZPREC) - z)) >> APREC;
+            dst[x] = (unsigned char)(z >> ZPREC);
+        }
+        dst[w-1] = 0; // force zero border
+        z = 0;
+        for (x = w-2; x >= 0; x--) {
+            z += (alpha * (((int)(dst[x]) << ZPREC) - z)) >> APREC;
+            dst[x] = (unsigned char)(z >> ZPREC);
+        }
+        dst[0] = 0; // force zero border
+        dst += dstStride;
+    }
+}
+
+// Filters one row into the running values of each column.
+static void fons__blurRowStepScalar(unsigned char* row, int* z, int w, int alpha)
+{
+    int x;
+    for (x = 0; x < w; x++) {
+        z[x] += (alpha * (((int)(row[x]) << ZPREC) - z[x])) >> APREC;
+        row[x] = (unsigned char)(z[x] >> ZPREC);
+    }
+}
+
+#if defined(FONS_SSE2)
+static void fons__blurRowStepSSE2(unsigned char* row, int* z, int w, int alpha)
+{
+    int x = 0;
+    const __m128i a = _mm_set1_epi32(alpha);
+    for (; x + 4 <= w; x += 4) {
+        int v;
+        __m128i p, zz, d, lo, hi;
+        memcpy(&v, &row[x], 4);
+        p = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), _mm_setzero_si128()), _mm_setzero_si128());
+        zz = _mm_loadu_si128((const __m128i*)&z[x]);
+        d = _mm_sub_epi32(_mm_slli_epi32(p, ZPREC), zz);
+        // 32-bit multiply, SSE2 only has the 32x32->64 one.
+        lo = _mm_shuffle_epi32(_mm_mul_epu32(a, d), _MM_SHUFFLE(0,0,2,0));
+        hi = _mm_shuffle_epi32(_mm_mul_epu32(a, _mm_srli_si128(d, 4)), _MM_SHUFFLE(0,0,2,0));
+        zz = _mm_add_epi32(zz, _mm_srai_epi32(_mm_unpacklo_epi32(lo, hi), APREC));
+        _mm_storeu_si128((__m128i*)&z[x], zz);
+        p = _mm_srai_epi32(zz, ZPREC);
+        p = _mm_packs_epi32(p, p);
+        v = _mm_cvtsi128_si32(_mm_packus_epi16(p, p));
+        memcpy(&row[x], &v, 4);
+    }
+    fons__blurRowStepScalar(&row[x], &z[x], w - x, alpha);
+}
+#endif
+
+#if defined(FONS_SSE41)
+static FONS_TARGET_SSE41 void fons__blurRowStepSSE41(unsigned char* row, int* z, int w, int alpha)
+{
+    int x = 0;
+    const __m128i a = _mm_set1_epi32(alpha);
+    for (; x + 4 <= w; x += 4) {
+        int v;
+        __m128i p, zz;
+        memcpy(&v, &row[x], 4);
+        p = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(v));
+        zz = _mm_loadu_si128((const __m128i*)&z[x]);
+        zz = _mm_add_epi32(zz, _mm_srai_epi32(_mm_mullo_epi32(a, _mm_sub_epi32(_mm_slli_epi32(p, ZPREC), zz)), APREC));
+        _mm_storeu_si128((__m128i*)&z[x], zz);
+        p = _mm_srai_epi32(zz, ZPREC);
+        p = _mm_packus_epi32(p, p);
+        v = _mm_cvtsi128_si32(_mm_packus_epi16(p, p));
+        memcpy(&row[x], &v, 4);
+    }
+    fons__blurRowStepScalar(&row[x], &z[x], w - x, alpha);
+}
+#endif
+
+#if defined(FONS_NEON)
+static void fons__blurRowStepNEON(unsigned char* row, int* z, int w, int alpha)
+{
+    int x = 0;
+    for (; x + 4 <= w; x += 4) {
+        uint32_t v;
+        int32x4_t p, zz;
+        uint16x4_t o;
+        memcpy(&v, &row[x], 4);
+        p = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(v))))));
+        zz = vld1q_s32(&z[x]);
+        zz = vaddq_s32(zz, vshrq_n_s32(vmulq_n_s32(vsubq_s32(vshlq_n_s32(p, ZPREC), zz), alpha), APREC));
+        vst1q_s32(&z[x], zz);
+        o = vmovn_u32(vreinterpretq_u32_s32(vshrq_n_s32(zz, ZPREC)));
+        v = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(o, o))), 0);
+        memcpy(&row[x], &v, 4);
+    }
+    fons__blurRowStepScalar(&row[x], &z[x], w - x, alpha);
+}
+#endif
+
+// Vertical pass, all the columns are filtered together walking down and up the rows.
+static void fons__blurRows(const FONSkernels* k, unsigned char* dst, int w, int h, int dstStride, int alpha, int* z)
+{
+    int y;
+    memset(z, 0, w * sizeof(int)); // force zero border
+    for (y = 1; y < h; y++)
+        k->blurRowStep(&dst[y*dstStride], z, w, alpha);
+    memset(&dst[(h-1)*dstStride], 0, w); // force zero border
+    memset(z, 0, w * sizeof(int));
+    for (y = h-2; y >= 0; y--)
+        k->blurRowStep(&dst[y*dstStride], z, w, alpha);
+    memset(dst, 0, w); // force zero border
+}
+
+// Box filter of radius r along the rows, src and dst must be different.
+static void fons__boxBlurCols(unsigned char* dst, const unsigned char* src, int w, int h, int r)
+{
+    int x, y, inv = (1<<16) / (2*r+1);
+    for (y = 0; y < h; y++) {
+        const unsigned char* s = &src[y*w];
+        unsigned char* d = &dst[y*w];
+        int sum = 0;
+        for (x = 0; x < r && x < w; x++)
+            sum += s[x];
+        for (x = 0; x < w; x++) {
+            if (x+r < w) sum += s[x+r];
+            d[x] = (unsigned char)((sum * inv + (1<<15)) >> 16);
+            if (x-r >= 0) sum -= s[x-r];
+        }
+    }
+}
+
+// Box filter of radius r along the columns, the running sums of all the columns are updated together.
+static void fons__boxBlurRows(unsigned char* dst, const unsigned char* src, int w, int h, int r, int* sums)
+{
+    int x, y, inv = (1<<16) / (2*r+1);
+    memset(sums, 0, w * sizeof(int));
+    for (y = 0; y < r && y < h; y++)
+        for (x = 0; x < w; x++)
+            sums[x] += src[y*w + x];
+    for (y = 0; y < h; y++) {
+        unsigned char* d = &dst[y*w];
+        if (y+r < h) {
+            const unsigned char* s = &src[(y+r)*w];
+            for (x = 0; x < w; x++)
+                sums[x] += s[x];
+        }
+        for (x = 0; x < w; x++)
+            d[x] = (unsigned char)((sums[x] * inv + (1<<15)) >> 16);
+        if (y-r >= 0) {
+            const unsigned char* s = &src[(y-r)*w];
+            for (x = 0; x < w; x++)
+                sums[x] -= s[x];
+        }
+    }
+}
+
+// Recursive gaussian filter of the glyph in place, z holds max(w, h) ints.
+static void fons__blurIIR(FONScontext* stash, unsigned char* dst, int w, int h, int dstStride, int blur, int* z)
+{
+    float sigma = (float)blur * 0.57735f; // 1 / sqrt(3)
+    // Calculate the alpha such that 90% of the kernel is within the radius. (Kernel extends to infinity)
+    int alpha = (int)((1<<APREC) * (1.0f - expf(-2.3f / (sigma+1.0f))));
+    fons__blurRows(&stash->kernels, dst, w, h, dstStride, alpha, z);
+    fons__blurCols(dst, w, h, dstStride, alpha);
+    fons__blurRows(&stash->kernels, dst, w, h, dstStride, alpha, z);
+    fons__blurCols(dst, w, h, dstStride, alpha);
+}
+
+static void fons__blur(FONScontext* stash, unsigned char* dst, int w, int h, int dstStride, int blur)
+{
+    int y, i, r, box, zsize, tilesize, size, heap;
+    float sigma;
+    unsigned char* mem;
+    unsigned char* tile;
+    unsigned char* tmp;
+    int* z;
+
+    if (blur < 1)
+        return;
+
+    // Blur a compact copy of the glyph unless it already is one, the atlas rows are too far apart for the vertical passes.
+    // Large radii lose precision in the recursive filter, they use three box filters of the same variance instead.
+    box = blur > FONS_BLUR_IIR_MAX;
+    zsize = (fons__maxi(w, h) * (int)sizeof(int) + 0xf) & ~0xf;
+    tilesize = dstStride != w ? (w * h + 0xf) & ~0xf : 0;
+    size = zsize + tilesize + (box ? w * h : 0);
+
+    // The temporaries of large glyphs do not fit the scratch buffer.
+    heap = size + 16 > FONS_SCRATCH_BUF_SIZE - stash->nscratch;
+    mem = heap ? (unsigned char*)malloc(size) : (unsigned char*)fons__tmpalloc(size, stash);
+    if (mem == NULL) {
+        // Out of memory, blur in place within the range of the recursive filter.
+        z = (int*)malloc(fons__maxi(w, h) * sizeof(int));
+        if (z == NULL) return;
+        fons__blurIIR(stash, dst, w, h, dstStride, fons__mini(blur, FONS_BLUR_IIR_MAX), z);
+        free(z);
+        return;
+    }
+    z = (int*)mem;
+    tile = tilesize > 0 ? mem + zsize : dst;
+    tmp = mem + zsize + tilesize;
+    if (tile != dst) {
+        for (y = 0; y < h; y++)
+            memcpy(&tile[y*w], &dst[y*dstStride], w);
+    }
+
+    if (box) {
+        sigma = (float)blur * 0.57735f; // 1 / sqrt(3)
+        r = (int)((sqrtf(4.0f * sigma*sigma + 1.0f) - 1.0f) * 0.5f + 0.5f);
+        for (i = 0; i < 3; i++) {
+            fons__boxBlurCols(tmp, tile, w, h, r);
+            fons__boxBlurRows(tile, tmp, w, h, r, z);
+        }
+        // force zero border
+        memset(tile, 0, w);
+        memset(&tile[(h-1)*w], 0, w);
+        for (y = 0; y < h; y++)
+            tile[y*w] = tile[y*w + w-1] = 0;
+    } else {
+        fons__blurIIR(stash, tile, w, h, w, blur, z);
+    }
+
+    if (tile != dst) {
+        for (y = 0; y < h; y++)
+            memcpy(&dst[y*dstStride], &tile[y*w], w);
+    }
+    if (heap)
+        free(mem);
+}
+
+#ifdef FONS_USE_THREADS
+
+// Worker threads for the distance fields of large glyphs, created on first use.
+struct FONSthreadPool
+{
+    std::mutex lock;
+    std::condition_variable start, done;
+    std::thread workers[FONS_MAX_THREADS];
+    int nworkers;
+    void (*job)(void* arg, int i);
+    void* arg;
+    int n, next, running;
+    unsigned int gen;
+    bool quit;
+};
+
+// Takes jobs until all of them are handed out, the lock is released while a job runs.
+static void fons__poolRun(FONSthreadPool* pool, std::unique_lock<std::mutex>& lk)
+{
+    while (pool->next < pool->n) {
+        int i = pool->next++;
+        pool->running++;
+        lk.unlock();
+        pool->job(pool->arg, i);
+        lk.lock();
+        if (--pool->running == 0 && pool->next >= pool->n)
+            pool->done.notify_all();
+    }
+}
+
+static void fons__poolWorker(FONSthreadPool* pool)
+{
+    std::unique_lock<std::mutex> lk(pool->lock);
+    unsigned int gen = pool->gen;
+    for (;;) {
+        while (!pool->quit && pool->gen == gen)
+            pool->start.wait(lk);
+        if (pool->quit) return;
+        gen = pool->gen;
+        fons__poolRun(pool, lk);
+    }
+}
+
+// SDFparallelFor on the pool, the calling thread takes jobs too.
+static void fons__poolFor(void* uptr, void (*job)(void* arg, int i), void* arg, int n)
+{
+    FONSthreadPool* pool = (FONSthreadPool*)uptr;
+    std::unique_lock<std::mutex> lk(pool->lock);
+    pool->job = job;
+    pool->arg = arg;
+    pool->n = n;
+    pool->next = 0;
+    pool->gen++;
+    if (n > 1) pool->start.notify_all();
+    fons__poolRun(pool, lk);
+    while (pool->running > 0)
+        pool->done.wait(lk);
+}
+
+// Returns NULL when there is only one hardware thread.
+static FONSthreadPool* fons__getPool(FONScontext* stash)
+{
+    int i, n = (int)std::thread::hardware_concurrency();
+    if (stash->pool != NULL) return stash->pool;
+    n = fons__mini(n, FONS_MAX_THREADS);
+    if (n < 2) return NULL;
+    stash->pool = new FONSthreadPool();
+    stash->pool->nworkers = n-1;
+    stash->pool->n = stash->pool->next = stash->pool->running = 0;
+    stash->pool->gen = 0;
+    stash->pool->quit = false;
+    for (i = 0; i < n-1; i++)
+        stash->pool->workers[i] = std::thread(fons__poolWorker, stash->pool);
+    return stash->pool;
+}
+
+static void fons__deletePool(FONSthreadPool* pool)
+{
+    int i;
+    if (pool == NULL) return;
+    {
+        std::lock_guard<std::mutex> lk(pool->lock);
+        pool->quit = true;
+    }
+    pool->start.notify_all();
+    for (i = 0; i < pool->nworkers; i++)
+        pool->workers[i].join();
+    delete pool;
+}
+
+#endif
+
+// Size of the temp array of the distance field engine for a w*h glyph built by njobs jobs.
+static int fons__distanceFieldTempSize(FONScontext* stash, int w, int h, int njobs)
+{
+    if (stash->sdfEngine == FONS_SDF_EDT)
+        return sdfEDTParallelTempSize(w, h, njobs);
+    else if (stash->sdfEngine == FONS_SDF_FIXED)
+        return sdfEDTTempSize(w, h);
+    else if (stash->sdfEngine == FONS_SDF_NARROW_BAND)
+        return sdfNarrowBandTempSize(w, h);
+    return w * h * sizeof(float) * 3; // The required temp array must fit width * height * sizeof(float) * 3 bytes.
+}
+
+// Builds the distance field of a glyph in place with the selected engine.
+static int fons__buildDistanceField(FONScontext* stash, unsigned char* dst, int w, int h, int stride, float radius)
+{
+    unsigned char* temp;
+    int size, heap, njobs = 1;
+#ifdef FONS_USE_THREADS
+    FONSthreadPool* pool = NULL;
+    // Large glyphs split the separable transform over the worker threads.
+    if (stash->sdfEngine == FONS_SDF_EDT && w * h > FONS_SDF_PARALLEL_PIXELS)
+        pool = fons__getPool(stash);
+    if (pool != NULL)
+        njobs = pool->nworkers + 1;
+#endif
+
+    size = fons__distanceFieldTempSize(stash, w, h, njobs);
+
+    // The temp array of large glyphs does not fit the scratch buffer.
+    heap = size + 16 > FONS_SCRATCH_BUF_SIZE - stash->nscratch;
+    if (heap)
+        temp = (unsigned char*)malloc(size);
+    else
+        temp = (unsigned char*)fons__tmpalloc(size, stash);
+    if (temp == NULL) return 0;
+
+    if (stash->sdfEngine == FONS_SDF_EDT) {
+#ifdef FONS_USE_THREADS
+        if (pool != NULL)
+            sdfBuildDistanceFieldEDTParallel(dst, stride, radius, dst, w, h, stride, temp, njobs, fons__poolFor, pool);
+        else
+#endif
+        sdfBuildDistanceFieldEDTNoAlloc(dst, stride, radius, dst, w, h, stride, temp);
+    } else if (stash->sdfEngine == FONS_SDF_NARROW_BAND) {
+        sdfBuildDistanceFieldNarrowBandNoAlloc(dst, stride, radius, dst, w, h, stride, temp);
+    } else if (stash->sdfEngine == FONS_SDF_FIXED) {
+        sdfBuildDistanceFieldEDTFixedNoAlloc(dst, stride, radius, dst, w, h, stride, temp);
+    } else {
+        sdfBuildDistanceFieldNoAlloc(dst, stride, radius, dst, w, h, stride, temp);
+    }
+
+    if (heap)
+        free(temp);
+    else
+        fons__tmpfree(temp, stash);
+    return 1;
+}
+
+// Converts the coverage of a glyph to a distance field with sdfCoverageToDistanceField or its fixed point version.
+static void fons__coverageToDistanceField(FONScontext* stash, unsigned char* dst, int dstStride,
+                                          const unsigned char* src, int w, int h, int srcStride)
+{
+    if (stash->sdfEngine == FONS_SDF_FIXED)
+        sdfCoverageToDistanceFieldFixed(dst, dstStride, src, w, h, srcStride);
+    else
+        sdfCoverageToDistanceFieldISA(dst, dstStride, src, w, h, srcStride, stash->kernels.sdfIsa);
+}
+
+// Returns the table mapping the distance field to the coverage of the grow effect, rebuilt when the blur changes.
+static const unsigned char* fons__growLut(FONScontext* stash, int blur)
+{
+    int i, limit = 255 / blur;
+    if (stash->growBlur != blur) {
+        for (i = 0; i < 256; i++)
+            stash->growLut[i] = (unsigned char)(i < limit ? i * 255 / limit : 255);
+        stash->growBlur = blur;
+    }
+    return stash->growLut;
+}
+
+// Writes a row of the grown glyph, mapping the distance field through the table on the way.
+static void fons__growRowScalar(unsigned char* dst, const unsigned char* src, int w, const unsigned char* lut, int limit)
+{
+    int x;
+    FONS_NOTUSED(limit);
+    for (x = 0; x < w; x++)
+        dst[x] = lut[src[x]];
+}
+
+// Runs of pixels that are all empty or past the ramp are mapped 16 at a time.
+#if defined(FONS_SSE2)
+static void fons__growRowSSE2(unsigned char* dst, const unsigned char* src, int w, const unsigned char* lut, int limit)
+{
+    int x = 0;
+    const __m128i lim = _mm_set1_epi8((char)limit), zero = _mm_setzero_si128();
+    for (; x + 16 <= w; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)&src[x]);
+        __m128i sat = _mm_cmpeq_epi8(_mm_max_epu8(v, lim), v);
+        if (_mm_movemask_epi8(_mm_or_si128(sat, _mm_cmpeq_epi8(v, zero))) == 0xffff)
+            _mm_storeu_si128((__m128i*)&dst[x], sat);
+        else
+            fons__growRowScalar(&dst[x], &src[x], 16, lut, limit);
+    }
+    fons__growRowScalar(&dst[x], &src[x], w - x, lut, limit);
+}
+#elif defined(FONS_NEON)
+static void fons__growRowNEON(unsigned char* dst, const unsigned char* src, int w, const unsigned char* lut, int limit)
+{
+    int x = 0;
+    const uint8x16_t lim = vdupq_n_u8((uint8_t)limit);
+    for (; x + 16 <= w; x += 16) {
+        uint8x16_t v = vld1q_u8(&src[x]);
+        uint8x16_t sat = vcgeq_u8(v, lim);
+        uint8x16_t any = vorrq_u8(sat, vceqq_u8(v, vdupq_n_u8(0)));
+        uint8x8_t all = vand_u8(vget_low_u8(any), vget_high_u8(any));
+        if (vget_lane_u64(vreinterpret_u64_u8(all), 0) == ~(uint64_t)0)
+            vst1q_u8(&dst[x], sat);
+        else
+            fons__growRowScalar(&dst[x], &src[x], 16, lut, limit);
+    }
+    fons__growRowScalar(&dst[x], &src[x], w - x, lut, limit);
+}
+#endif
+
+// Widens the ASCII bytes at the start of src to codepoints, returns how many there are.
+static int fons__decodeASCIIScalar(const unsigned char* src, int n, unsigned int* dst)
+{
+    int i;
+    for (i = 0; i < n && src[i] < 0x80; i++)
+        dst[i] = src[i];
+    return i;
+}
+
+// Blocks of 16 ASCII bytes are widened at once.
+#if defined(FONS_SSE2)
+static int fons__decodeASCIISSE2(const unsigned char* src, int n, unsigned int* dst)
+{
+    int i = 0;
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)&src[i]);
+        __m128i lo, hi;
+        if (_mm_movemask_epi8(v) != 0)
+            break;
+        lo = _mm_unpacklo_epi8(v, zero);
+        hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_si128((__m128i*)&dst[i], _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128((__m128i*)&dst[i+4], _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128((__m128i*)&dst[i+8], _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128((__m128i*)&dst[i+12], _mm_unpackhi_epi16(hi, zero));
+    }
+    return i + fons__decodeASCIIScalar(&src[i], n - i, &dst[i]);
+}
+#elif defined(FONS_NEON)
+static int fons__decodeASCIINEON(const unsigned char* src, int n, unsigned int* dst)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(&src[i]);
+        uint8x8_t any = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+        uint16x8_t lo, hi;
+        if (vget_lane_u64(vreinterpret_u64_u8(any), 0) & 0x8080808080808080ull)
+            break;
+        lo = vmovl_u8(vget_low_u8(v));
+        hi = vmovl_u8(vget_high_u8(v));
+        vst1q_u32(&dst[i], vmovl_u16(vget_low_u16(lo)));
+        vst1q_u32(&dst[i+4], vmovl_u16(vget_high_u16(lo)));
+        vst1q_u32(&dst[i+8], vmovl_u16(vget_low_u16(hi)));
+        vst1q_u32(&dst[i+12], vmovl_u16(vget_high_u16(hi)));
+    }
+    return i + fons__decodeASCIIScalar(&src[i], n - i, &dst[i]);
+}
+#endif
+
+static void fons__growRows(const FONSkernels* k, unsigned char* dst, int dstStride, const unsigned char* src, int srcStride,
+                           int w, int h, const unsigned char* lut, int limit)
+{
+    int y;
+    for (y = 0; y < h; y++)
+        k->growRow(&dst[y * dstStride], &src[y * srcStride], w, lut, limit);
+}
+
+// SIMD instruction sets supported by the running CPU.
+enum FONScpuFeatures {
+    FONS_CPU_SSE2 = 1,
+    FONS_CPU_SSE41 = 2,
+    FONS_CPU_AVX2 = 4,
+    FONS_CPU_NEON = 8,
+};
+
+// Returns the instruction sets the kernels were built for which the running CPU supports.
+static int fons__cpuFeatures()
+{
+    int features = 0;
+#if defined(FONS_SSE2)
+    features |= FONS_CPU_SSE2;
+#	if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) features |= FONS_CPU_SSE41;
+    if (__builtin_cpu_supports("avx2")) features |= FONS_CPU_AVX2;
+#	elif defined(_MSC_VER)
+    {
+        int info[4];
+        __cpuid(info, 1);
+        if (info[2] & (1 << 19)) features |= FONS_CPU_SSE41;
+        // AVX2 also needs the OS to save the YMM registers.
+        if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5)) features |= FONS_CPU_AVX2;
+        }
+    }
+#	endif
+#elif defined(FONS_NEON)
+    features |= FONS_CPU_NEON;
+#endif
+    return features;
+}
+
+static void fons__initKernels(FONSkernels* k)
+{
+    int cpu = fons__cpuFeatures();
+    FONS_NOTUSED(cpu);
+
+    k->blurRowStep = fons__blurRowStepScalar;
+    k->growRow = fons__growRowScalar;
+    k->decodeASCII = fons__decodeASCIIScalar;
+#ifdef FONS_USE_COVERAGE_RASTERIZER
+    k->accumulateRow = fons__accumulateRowScalar;
+#endif
+    k->sdfIsa = SDF_ISA_SCALAR;
+
+#if defined(FONS_SSE2)
+    if (cpu & FONS_CPU_SSE2) {
+        k->blurRowStep = fons__blurRowStepSSE2;
+        k->growRow = fons__growRowSSE2;
+        k->decodeASCII = fons__decodeASCIISSE2;
+#	ifdef FONS_USE_COVERAGE_RASTERIZER
+        k->accumulateRow = fons__accumulateRowSSE2;
+#	endif
+        if (sdfHasISA(SDF_ISA_SSE2)) k->sdfIsa = SDF_ISA_SSE2;
+    }
+#	if defined(FONS_SSE41)
+    if (cpu & FONS_CPU_SSE41)
+        k->blurRowStep = fons__blurRowStepSSE41;
+#	endif
+    if ((cpu & FONS_CPU_AVX2) && sdfHasISA(SDF_ISA_AVX2))
+        k->sdfIsa = SDF_ISA_AVX2;
+#elif defined(FONS_NEON)
+    if (cpu & FONS_CPU_NEON) {
+        k->blurRowStep = fons__blurRowStepNEON;
+        k->growRow = fons__growRowNEON;
+        k->decodeASCII = fons__decodeASCIINEON;
+#	ifdef FONS_USE_COVERAGE_RASTERIZER
+        k->accumulateRow = fons__accumulateRowNEON;
+#	endif
+        if (sdfHasISA(SDF_ISA_NEON)) k->sdfIsa = SDF_ISA_NEON;
+    }
+#endif
+}
+
+// Decodes the UTF-8 string into stash->codepoints, up to the first invalid byte as fons__decutf8 does.
+// The same string at the same address as the last call, with the same bytes, is not decoded again.
+// Returns the number of codepoints, -1 when out of memory.
+static int fons__decodeText(FONScontext* stash, const char* str, const char* end)
+{
+    const unsigned char* src = (const unsigned char*)str;
+    unsigned int utf8state = 0;
+    unsigned int codepoint;
+    int len = (int)(end - str);
+    int i = 0, n = 0;
+
+    if (stash->decodedStr != NULL && str == stash->decodedStr && len == stash->decodedLen && memcmp(str, stash->decodedText, len) == 0)
+        return stash->ndecoded;
+    stash->decodedStr = NULL;
+
+    // The copy of the bytes follows the codepoints in the same allocation.
+    if (len > stash->ccodepoints) {
+        int ccodepoints = fons__maxi(len, stash->ccodepoints * 2);
+        unsigned int* codepoints = (unsigned int*)realloc(stash->codepoints, (sizeof(unsigned int) + 1) * ccodepoints);
+        if (codepoints == NULL) return -1;
+        stash->codepoints = codepoints;
+        stash->ccodepoints = ccodepoints;
+        stash->decodedText = (char*)(codepoints + ccodepoints);
+    }
+
+    while (i < len) {
+        if (utf8state == FONS_UTF8_ACCEPT && src[i] < 0x80) {
+            int ascii = stash->kernels.decodeASCII(&src[i], len - i, &stash->codepoints[n]);
+            i += ascii;
+            n += ascii;
+            continue;
+        }
+        if (!fons__decutf8(&utf8state, &codepoint, src[i++]))
+            stash->codepoints[n++] = codepoint;
+        else if (utf8state == FONS_UTF8_REJECT)
+            break;
+    }
+
+    if (len > 0) {
+        memcpy(stash->decodedText, str, len);
+        stash->decodedStr = str;
+        stash->decodedLen = len;
+        stash->ndecoded = n;
+    }
+    return n;
+}
+
+// Writes the glyph averaged over blocks of ds*ds pixels, w and h are the reduced size.
+// The one texel border is kept empty.
+static void fons__downsample(unsigned char* dst, int dstStride, const unsigned char* src, int srcStride,
+                             int w, int h, int ds)
+{
+    int x, y, i, j, n = ds*ds;
+    memset(dst, 0, w);
+    memset(&dst[(h-1)*dstStride], 0, w);
+    for (y = 1; y < h-1; y++) {
+        unsigned char* d = &dst[y * dstStride];
+        const unsigned char* s = &src[y*ds * srcStride];
+        d[0] = d[w-1] = 0;
+        for (x = 1; x < w-1; x++) {
+            int sum = n/2;
+            for (j = 0; j < ds; j++)
+                for (i = 0; i < ds; i++)
+                    sum += s[x*ds+i + j*srcStride];
+            d[x] = (unsigned char)(sum / n);
+        }
+    }
+}
+
+// Scratch bytes the rasterizer and the effect of a gw*gh glyph tile use after the tile, bw*bh is the glyph box.
+static int fons__glyphTempSize(FONScontext* stash, int gw, int gh, int bw, int bh, short iblur, int blurType, int useOutline)
+{
+    int temp = 0;
+#ifdef FONS_USE_COVERAGE_RASTERIZER
+    if (useOutline)
+        temp = (bw * bh + 4) * (int)sizeof(float) + 16;
+#else
+    FONS_NOTUSED(bw);
+    FONS_NOTUSED(bh);
+    FONS_NOTUSED(useOutline);
+#endif
+    if (iblur > 0 && blurType == FONS_EFFECT_BLUR)
+        temp = fons__maxi(temp, fons__maxi(gw, gh) * (int)sizeof(int) + (iblur > FONS_BLUR_IIR_MAX ? gw * gh : 0) + 32);
+    else if (iblur > 0 && (blurType == FONS_EFFECT_DISTANCE_FIELD || blurType == FONS_EFFECT_GROW))
+        temp = fons__maxi(temp, fons__distanceFieldTempSize(stash, gw, gh, 1) + 16);
+    return temp;
+}
+
+static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned int codepoint,
+                                 short isize, short iblur, int blurType)
+{
+    int i, g, advance, lsb, x0, y0, x1, y1, gw, gh, gx, gy, x, y;
+    float scale;
+    FONSglyph* glyph = NULL;
+    unsigned int h;
+    float size = isize/10.0f;
+    int pad, added, tstride, tileEnd, blit, ds, aw, ah, temp;
+    unsigned char* atlasDst;
+    unsigned char* tile;
+    unsigned char* dst;
+    FONSatlas* atlas = stash->atlas;
+    FONSglyphOutline outline = {0};
+    int useOutline = 0, ftSdf = 0;
+
+    if (isize < 2) return NULL;
+    // Distance field glyphs with a shared spread are the same whatever the blur of the text.
+    if (blurType == FONS_EFFECT_DISTANCE_FIELD && stash->sdfSpread > 0)
+        iblur = stash->sdfSpread;
+    if (blurType == FONS_EFFECT_BLUR) {
+        if (iblur > FONS_MAX_BLUR) iblur = FONS_MAX_BLUR;
+    } else if (iblur > 20) {
+        iblur = 20;
+    }
+    pad = iblur+2;
+
+    // Reset allocator.
+    stash->nscratch = 0;
+
+    // Find code point and size.
+    h = fons__hashint(codepoint) & (FONS_HASH_LUT_SIZE-1);
+    i = font->lut[h];
+    while (i != -1) {
+        if (font->glyphs[i].codepoint == codepoint && font->glyphs[i].size == isize
+                && font->glyphs[i].blur == iblur && font->glyphs[i].blurType == blurType)
+            return &font->glyphs[i];
+        i = font->glyphs[i].next;
+    }
+
+    // Could not find glyph, create it.
+    scale = fons__tt_getPixelHeightScale(&font->font, size);
+    if (codepoint & FONS_GLYPH_INDEX)
+        g = (int)(codepoint & ~FONS_GLYPH_INDEX);
+    else
+        g = fons__tt_getGlyphIndex(&font->font, codepoint, 0);
+    if (g == 0) {
+        return NULL;
+    }
+
+    // Cached outlines skip decoding the glyph again for each size, MSDF needs the outline anyway.
+#if defined(FONS_USE_OUTLINE_CACHE) || defined(FONS_USE_COVERAGE_RASTERIZER)
+    useOutline = 1;
+#endif
+    if (useOutline || blurType == FONS_EFFECT_MSDF)
+        useOutline = fons__getGlyphOutline(stash, font, g, &outline);
+    if (useOutline) {
+        advance = outline.advance;
+        fons__getOutlineBitmapBox(&outline, scale, &x0, &y0, &x1, &y1);
+    } else {
+        fons__tt_buildGlyphBitmap(&font->font, g, size, scale, &advance, &lsb, &x0, &y0, &x1, &y1);
+    }
+    gw = x1-x0 + pad*2;
+    gh = y1-y0 + pad*2;
+
+    // Reduced resolution distance fields are built at full size in the scratch tile and averaged over
+    // blocks of ds*ds pixels, the padding leaves room for the quad inset of one texel on each side.
+    // The atlas rect only holds the reduced glyph, so they are stored at full size when the tile and
+    // its temporaries don't fit the scratch buffer.
+    ds = blurType == FONS_EFFECT_DISTANCE_FIELD ? stash->sdfDownsample : 1;
+    if (ds > 1) {
+        int dpad = iblur + ds*2;
+        int dw = (x1-x0 + dpad*2 + ds-1) / ds * ds;
+        int dh = (y1-y0 + dpad*2 + ds-1) / ds * ds;
+        if (dw * dh + 16 + fons__glyphTempSize(stash, dw, dh, x1-x0, y1-y0, iblur, blurType, useOutline) <= FONS_SCRATCH_BUF_SIZE) {
+            pad = dpad;
+            gw = dw;
+            gh = dh;
+        } else {
+            ds = 1;
+        }
+    }
+    aw = gw / ds;
+    ah = gh / ds;
+
+    // Multi-channel distance fields live in their own RGB page.
+    if (blurType == FONS_EFFECT_MSDF) {
+        if (!fons__allocPageRGB(stash)) return NULL;
+        atlas = stash->atlasRGB;
+    }
+
+    // Find free spot for the rect in the atlas
+    added = fons__atlasAddRect(atlas, aw, ah, &gx, &gy);
+    if (added == 0 && stash->handleError != NULL) {
+        // Atlas is full, let the user to resize the atlas (or not), and try again.
+        stash->handleError(stash->errorUptr, FONS_ATLAS_FULL, 0);
+        atlas = blurType == FONS_EFFECT_MSDF ? stash->atlasRGB : stash->atlas;
+        added = fons__atlasAddRect(atlas, aw, ah, &gx, &gy);
+    }
+    if (added == 0) return NULL;
+
+    // Init glyph.
     glyph = fons__allocGlyph(font);
     glyph->codepoint = codepoint;
     glyph->size = isize;
@@ -1344,89 +3708,122 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
     glyph->index = g;
     glyph->x0 = (short)gx;
     glyph->y0 = (short)gy;
-    glyph->x1 = (short)(glyph->x0+gw);
-    glyph->y1 = (short)(glyph->y0+gh);
+    glyph->x1 = (short)(glyph->x0+aw);
+    glyph->y1 = (short)(glyph->y0+ah);
     glyph->xadv = (short)(scale * advance * 10.0f);
     glyph->xoff = (short)(x0 - pad);
     glyph->yoff = (short)(y0 - pad);
+    glyph->downsample = (short)ds;
     glyph->next = 0;
 
     // Insert char to hash lookup.
     glyph->next = font->lut[h];
     font->lut[h] = font->nglyphs-1;
 
-    // Rasterize
-    dst = &stash->texData[(glyph->x0+pad) + (glyph->y0+pad) * stash->params.width];
-    fons__tt_renderGlyphBitmap(&font->font, dst, gw-pad*2,gh-pad*2, stash->params.width, scale,scale, g);
+    if (blurType == FONS_EFFECT_MSDF) {
+        int stride = stash->params.width * 3;
+        dst = &stash->texDataRGB[glyph->x0*3 + glyph->y0 * stride];
+        if (useOutline)
+            fons__buildGlyphMSDF(stash, &outline, scale, x0 - pad, y0 - pad, dst, gw, gh, stride, iblur > 0 ? iblur : 1);
+
+        // Make sure there is one pixel empty border.
+        for (y = 0; y < gh; y++) {
+            memset(&dst[y*stride], 0, 3);
+            memset(&dst[(gw-1)*3 + y*stride], 0, 3);
+        }
+        memset(dst, 0, gw*3);
+        memset(&dst[(gh-1)*stride], 0, gw*3);
+        stash->nscratch = 0;
+
+        stash->dirtyRectRGB[0] = fons__mini(stash->dirtyRectRGB[0], glyph->x0);
+        stash->dirtyRectRGB[1] = fons__mini(stash->dirtyRectRGB[1], glyph->y0);
+        stash->dirtyRectRGB[2] = fons__maxi(stash->dirtyRectRGB[2], glyph->x1);
+        stash->dirtyRectRGB[3] = fons__maxi(stash->dirtyRectRGB[3], glyph->y1);
+        return glyph;
+    }
+
+    // Rasterize into a compact scratch tile, run the effects there and copy the glyph to the atlas once.
+    // Glyphs whose tile and temporaries don't fit the scratch buffer together are processed in place in the atlas,
+    // downsampled glyphs always fit as they were checked with the same sizes above.
+    atlasDst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
+    stash->nscratch = 0;
+    temp = fons__glyphTempSize(stash, gw, gh, gw-pad*2, gh-pad*2, iblur, blurType, useOutline);
+    if (gw * gh + 16 + temp <= FONS_SCRATCH_BUF_SIZE) {
+        tile = (unsigned char*)fons__tmpalloc(gw * gh, stash);
+        tstride = gw;
+        memset(tile, 0, gw * gh);
+    } else {
+        tile = atlasDst;
+        tstride = stash->params.width;
+    }
+    blit = tile != atlasDst;
+    tileEnd = stash->nscratch;
+
+    dst = &tile[pad + pad * tstride];
+    // FreeType builds the distance field from the outline itself, no coverage is needed.
+    if ((blurType == FONS_EFFECT_DISTANCE_FIELD || blurType == FONS_EFFECT_GROW) && iblur > 0
+            && stash->sdfEngine == FONS_SDF_FREETYPE)
+        ftSdf = fons__tt_renderGlyphSDF(&font->font, g, size, iblur, tile, gw, gh, tstride, x0 - pad, y0 - pad);
+    if (useOutline && !ftSdf) {
+#ifdef FONS_USE_COVERAGE_RASTERIZER
+        if (!fons__rasterizeOutline(stash, &outline, scale, x0, y0, dst, gw-pad*2, gh-pad*2, tstride))
+#endif
+        fons__tt_renderGlyphOutline(stash, &font->font, dst, gw-pad*2, gh-pad*2, tstride, scale, x0, y0, &outline);
+    } else if (!ftSdf)
+        fons__tt_renderGlyphBitmap(&font->font, dst, gw-pad*2,gh-pad*2, tstride, scale,scale, g);
 
     // Make sure there is one pixel empty border.
-    dst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
     for (y = 0; y < gh; y++) {
-        dst[y*stash->params.width] = 0;
-        dst[gw-1 + y*stash->params.width] = 0;
+        tile[y*tstride] = 0;
+        tile[gw-1 + y*tstride] = 0;
     }
     for (x = 0; x < gw; x++) {
-        dst[x] = 0;
-        dst[x + (gh-1)*stash->params.width] = 0;
+        tile[x] = 0;
+        tile[x + (gh-1)*tstride] = 0;
     }
 
     // Blur
     if (iblur > 0) {
-        stash->nscratch = 0;
-        bdst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
+        stash->nscratch = tileEnd;
 
         if (blurType == FONS_EFFECT_BLUR) {
-            fons__blur(stash, bdst, gw,gh, stash->params.width, iblur);
+            fons__blur(stash, tile, gw,gh, tstride, iblur);
         } else if (blurType == FONS_EFFECT_GROW) {
-            unsigned char* sdfTemp = (unsigned char*)fons__tmpalloc(gw * gh * sizeof(float) * 3, stash);
-            if (sdfTemp) {
-                sdfBuildDistanceFieldNoAlloc(bdst, stash->params.width, iblur, bdst, gw, gh, stash->params.width, sdfTemp);
-                fons__tmpfree(sdfTemp, stash);
-
-                for (y = 0; y < gh; y++) {
-                    int yw = y * stash->params.width;
-                    for (x = 0; x < gw; x++) {
-                        int a = (int) bdst[x+ yw];
-                        int smoothingLimit = 255 / (iblur);
-                        if (a < smoothingLimit)
-                            a = a * 255 / smoothingLimit;
-                        else
-                            a = 255;
-
-                        bdst[x + yw] = a;
-                    }
-                }
+            // The distance to coverage mapping is done while writing the glyph to the texture data.
+            if (ftSdf || fons__buildDistanceField(stash, tile, gw, gh, tstride, iblur)) {
+                fons__growRows(&stash->kernels, atlasDst, stash->params.width, tile, tstride, gw, gh, fons__growLut(stash, iblur), 255 / iblur);
+                blit = 0;
             }
 
         } else if (blurType == FONS_EFFECT_DISTANCE_FIELD) {
-            // The required temp array must fit width * height * sizeof(float) * 3 bytes.
-            unsigned char* sdfTemp = (unsigned char*)fons__tmpalloc(gw * gh * sizeof(float) * 3, stash);
-            if (sdfTemp) {
-                sdfBuildDistanceFieldNoAlloc(bdst, stash->params.width, iblur, bdst, gw, gh, stash->params.width, sdfTemp);
-                fons__tmpfree(sdfTemp, stash);
-            }
+            if (!ftSdf)
+                fons__buildDistanceField(stash, tile, gw, gh, tstride, iblur);
 
         } else if (blurType == FONS_EFFECT_DISTANCE_FIELD_FAST) {
-            // When using sdfCoverageToDistanceField input and output must be separate arrays. Allocate temp array for output.
-            unsigned char* sdfOut = (unsigned char*)fons__tmpalloc(gw * gh, stash);
-            if (sdfOut) {
-                sdfCoverageToDistanceField(sdfOut, gw, bdst, gw, gh, stash->params.width);
-
-                // Copy SDF output back to the strided texture data.
-                i = 0;
-                for (y = 0; y < gh; y++) {
-                    int yw = y * stash->params.width;
-                    for (x = 0; x < gw; x++) {
-                        bdst[x + yw] = sdfOut[i];
-                        i++;
-                    }
+            // When using sdfCoverageToDistanceField input and output must be separate arrays.
+            // The tile is the input and the distance field is written straight to the texture data.
+            if (blit) {
+                fons__coverageToDistanceField(stash, atlasDst, stash->params.width, tile, gw, gh, gw);
+                blit = 0;
+            } else {
+                unsigned char* sdfIn = (unsigned char*)fons__tmpalloc(gw * gh, stash);
+                if (sdfIn) {
+                    for (y = 0; y < gh; y++)
+                        memcpy(&sdfIn[y * gw], &atlasDst[y * stash->params.width], gw);
+                    fons__coverageToDistanceField(stash, atlasDst, stash->params.width, sdfIn, gw, gh, gw);
+                    fons__tmpfree(sdfIn, stash);
                 }
-                fons__tmpfree(sdfOut, stash);
             }
         }
+    }
 
-        stash->nscratch = 0;
+    if (ds > 1) {
+        fons__downsample(atlasDst, stash->params.width, tile, tstride, aw, ah, ds);
+    } else if (blit) {
+        for (y = 0; y < gh; y++)
+            memcpy(&atlasDst[y * stash->params.width], &tile[y * gw], gw);
     }
+    stash->nscratch = 0;
 
     stash->dirtyRect[0] = fons__mini(stash->dirtyRect[0], glyph->x0);
     stash->dirtyRect[1] = fons__mini(stash->dirtyRect[1], glyph->y0);
@@ -1439,21 +3836,23 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 static void fons__getQuad(FONScontext* stash, FONSfont* font,
                           int prevGlyphIndex, FONSglyph* glyph,
                           float scale, float spacing, float* x, float* y, FONSquad* q,
-                          int useShaping)
+                          const FONSshapingRes* shaped, int it)
 {
     float rx,ry,xoff,yoff,x0,y0,x1,y1,xadv,yadv;
+    int ds = glyph->downsample;
 
-    if(!useShaping) {
+    if(!shaped) {
         if (prevGlyphIndex != -1) {
-            float adv = fons__tt_getGlyphKernAdvance(&font->font, prevGlyphIndex, glyph->index) * scale;
+            float adv = fons__getKerning(&font->kerning, prevGlyphIndex, glyph->index) * scale;
             *x += (int)(adv + spacing + 0.5f);
         }
 
         // Each glyph has 2px border to allow good interpolation,
         // one pixel to prevent leaking, and one to allow good interpolation for rendering.
         // Inset the texture region by one pixel for corret interpolation.
-        xoff = (short)(glyph->xoff+1);
-        yoff = (short)(glyph->yoff+1);
+        // Downsampled glyphs cover ds pixels per texel.
+        xoff = (short)(glyph->xoff+ds);
+        yoff = (short)(glyph->yoff+ds);
         q->s0 = x0 = (float)(glyph->x0+1);
         q->t0 = y0 = (float)(glyph->y0+1);
         q->s1 = x1 = (float)(glyph->x1-1);
@@ -1472,8 +3871,8 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 
             q->x0 = rx;
             q->y0 = ry;
-            q->x1 = rx + x1 - x0;
-            q->y1 = ry + y1 - y0;
+            q->x1 = rx + (x1 - x0) * ds;
+            q->y1 = ry + (y1 - y0) * ds;
 
         } else {
             rx = (float)(int)(*x + xoff);
@@ -1481,22 +3880,20 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 
             q->x0 = rx;
             q->y0 = ry;
-            q->x1 = rx + x1 - x0;
-            q->y1 = ry - y1 + y0;
+            q->x1 = rx + (x1 - x0) * ds;
+            q->y1 = ry - (y1 - y0) * ds;
 
         }
 
         *x += (int)(glyph->xadv / 10.0f + 0.5f);
     } else {
         // TODO : kerning
-        FONSshapingRes* shaping = stash->shaping->result;
-        int it = stash->shaping->it;
         float unitFontScale = fons__tt_getUnitScale();
 
-        xadv = (float)shaping->advance[it] * unitFontScale;
-        yadv = (float)shaping->advance[it+1] * unitFontScale;
-        xoff = (float)shaping->offset[it] * unitFontScale + 1;
-        yoff = (float)shaping->offset[it+1] * unitFontScale + 1;
+        xadv = (float)shaped->advance[it] * unitFontScale;
+        yadv = (float)shaped->advance[it+1] * unitFontScale;
+        xoff = (float)shaped->offset[it] * unitFontScale + ds;
+        yoff = (float)shaped->offset[it+1] * unitFontScale + ds;
         q->s0 = x0 = (float)(glyph->x0+1);
         q->t0 = y0 = (float)(glyph->y0+1);
         q->s1 = x1 = (float)(glyph->x1-1);
@@ -1514,8 +3911,8 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 
         q->x0 = rx + glyph->xoff;
         q->y0 = ry + glyph->yoff;
-        q->x1 = q->x0 + x1 - x0;
-        q->y1 = q->y0 + y1 - y0;
+        q->x1 = q->x0 + (x1 - x0) * ds;
+        q->y1 = q->y0 + (y1 - y0) * ds;
 
         *x += (int)(xadv + 0.5f);
         *y += (int)(yadv + 0.5f);
@@ -1534,6 +3931,14 @@ static void fons__flush(FONScontext* stash, const char clear)
         stash->dirtyRect[2] = 0;
         stash->dirtyRect[3] = 0;
     }
+    if (stash->dirtyRectRGB[0] < stash->dirtyRectRGB[2] && stash->dirtyRectRGB[1] < stash->dirtyRectRGB[3]) {
+        if (stash->params.renderUpdateRGB != NULL)
+            stash->params.renderUpdateRGB(stash->params.userPtr, stash->dirtyRectRGB, stash->texDataRGB);
+        stash->dirtyRectRGB[0] = stash->params.width;
+        stash->dirtyRectRGB[1] = stash->params.height;
+        stash->dirtyRectRGB[2] = 0;
+        stash->dirtyRectRGB[3] = 0;
+    }
 
     // Flush triangles
     if (stash->nverts > 0) {
@@ -1580,6 +3985,32 @@ static float fons__getVertAlign(FONScontext* stash, FONSfont* font, int align, s
     return 0.0;
 }
 
+// Offset of the start of a text of the given advance.
+static float fons__getHorizAlign(int align, float advance)
+{
+    if (align & FONS_ALIGN_LEFT) {
+        return 0.0f;
+    } else if (align & FONS_ALIGN_RIGHT) {
+        return -advance;
+    } else if (align & FONS_ALIGN_CENTER) {
+        return -advance * 0.5f;
+    }
+    return 0.0f;
+}
+
+// Moves the quads emitted from 0 since vertex first to start at x, on the pixels fons__getQuad would have put them.
+static void fons__moveQuads(FONScontext* stash, int first, float x)
+{
+    float dx;
+    int i, j;
+
+    for (i = first; i + 6 <= stash->nverts; i += 6) {
+        dx = (float)(int)(x + stash->verts[i*2]) - stash->verts[i*2];
+        for (j = i; j < i + 6; j++)
+            stash->verts[j*2] += dx;
+    }
+}
+
 static __inline void fons__vertices(FONScontext* stash, FONSquad q, FONSstate* state)
 {
     if (stash->params.pushQuad) {
@@ -1595,6 +4026,51 @@ static __inline void fons__vertices(FONScontext* stash, FONSquad q, FONSstate* s
     fons__vertex(stash, q.x1, q.y1, q.s1, q.t1, state->color);
 }
 
+// Emits the quads of shaped glyphs, invalid is set when one of them can't be rasterized.
+static float fons__drawShaped(FONScontext* stash, FONSfont* font, const FONSshapingRes* res, short isize,
+                              float x, float y, const char clear, int* invalid)
+{
+    FONSstate* state = fons__getState(stash);
+    FONSglyph* glyph;
+    FONSquad q;
+    int prevGlyphIndex = -1;
+    short iblur = (short)state->blur;
+    float scale = fons__tt_getPixelHeightScale(&font->font, (float)isize/10.0f);
+    float advance = 0.0f;
+    unsigned int i, j;
+
+    // Align horizontally, the advance of shaped glyphs is known without looking them up.
+    if (!(state->align & FONS_ALIGN_LEFT) && (state->align & (FONS_ALIGN_RIGHT | FONS_ALIGN_CENTER))) {
+        for (i = 0, j = 0; i < res->glyphCount; i++, j+=2) {
+            if (res->codepoints[i] != 0)
+                advance += (int)(res->advance[j] * fons__tt_getUnitScale() + 0.5f);
+        }
+        x += fons__getHorizAlign(state->align, advance);
+    }
+
+    for (i = 0, j = 0; i < res->glyphCount; i++, j+=2) {
+        if (res->codepoints[i] == 0) {
+            continue;
+        }
+        glyph = fons__getGlyph(stash, font, res->codepoints[i] | FONS_GLYPH_INDEX, isize, iblur, state->blurType);
+
+        if (glyph != NULL) {
+            fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q, res, j);
+
+            if (stash->nverts+6 > FONS_VERTEX_COUNT)
+                fons__flush(stash, clear);
+
+            fons__vertices(stash, q, state);
+        } else {
+            *invalid |= 1;
+        }
+        prevGlyphIndex = glyph != NULL ? glyph->index : -1;
+    }
+
+    fons__flush(stash, clear);
+    return x;
+}
+
 void fonsSetShaping(FONScontext* stash)
 {
     stash->shaping->customConfig = false;
@@ -1610,6 +4086,25 @@ void fonsSetShaping(FONScontext* stash, FONSscript script, FONSdirection directi
     fons__getState(stash)->useShaping = true;
 }
 
+void fonsSetShapingFeatures(FONScontext* stash, const char* features)
+{
+    if (stash == NULL || stash->shaping == NULL) return;
+    fons__hb_setFeatures(stash, features);
+}
+
+void fonsGetShapingCacheStats(FONScontext* stash, int* hits, int* misses)
+{
+    *hits = *misses = 0;
+#ifdef FONS_USE_HARFBUZZ
+    if (stash->shaping) {
+        *hits = stash->shaping->cache.hits;
+        *misses = stash->shaping->cache.misses;
+    }
+#else
+    FONS_NOTUSED(stash);
+#endif
+}
+
 bool fonsTextDrawable(FONScontext* stash, const char* str, const char* end, char cacheshaping)
 {
     if (stash == NULL) return -1;
@@ -1635,14 +4130,14 @@ bool fonsTextDrawable(FONScontext* stash, const char* str, const char* end, char
         FONSshaping* shaping = stash->shaping;
 
         if(shaping) {
-            unsigned int i, j;
-            shaping->result = (FONSshapingRes*) malloc(sizeof(FONSshapingRes));
+            unsigned int i;
 
-            fons__tt_setPixelSize(&font->font, (float)isize / 10.0f);
-            fons__hb_shape(stash, str, font);
+            if (!fons__hb_shape(stash, str, end, font, isize, &shaping->view)) {
+                return false;
+            }
+            shaping->result = &shaping->view;
 
-            for (i = 0, j = 0; i < shaping->result->glyphCount; i++, j+=2) {
-                shaping->it = j;
+            for (i = 0; i < shaping->result->glyphCount; i++) {
                 codepoint = shaping->result->codepoints[i];
                 if (codepoint == 0) {
                     fons__clearShaping(stash);
@@ -1653,147 +4148,646 @@ bool fonsTextDrawable(FONScontext* stash, const char* str, const char* end, char
             if(!cacheshaping) {
                 fons__clearShaping(stash);
             }
-        } else {
-            return false;
+        } else {
+            return false;
+        }
+    } else {
+        int i, n, g;
+
+        if (end == NULL)
+            end = str + strlen(str);
+
+        n = fons__decodeText(stash, str, end);
+        if (n < 0) {
+            return false;
+        }
+
+        for (i = 0; i < n; i++) {
+            codepoint = stash->codepoints[i];
+            if (codepoint == 0) {
+                return false;
+            }
+
+            g = fons__tt_getGlyphIndex(&font->font, codepoint, 0);
+            if (g == 0) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Bounds of n decoded codepoints drawn with font and the current state, see fonsTextBounds.
+static float fons__textBounds(FONScontext* stash, FONSfont* font, float x, float y,
+                              const unsigned int* codepoints, int n, float* bounds)
+{
+    FONSstate* state = fons__getState(stash);
+    FONSquad q;
+    FONSglyph* glyph = NULL;
+    int prevGlyphIndex = -1;
+    short isize = (short)(state->size*10.0f);
+    short iblur = (short)state->blur;
+    int blurType = state->blurType;
+    float scale;
+    float startx, advance;
+    float minx, miny, maxx, maxy;
+    int i;
+
+    scale = fons__tt_getPixelHeightScale(&font->font, (float)isize/10.0f);
+
+    // Align vertically.
+    y += fons__getVertAlign(stash, font, state->align, isize);
+
+    minx = maxx = x;
+    miny = maxy = y;
+    startx = x;
+
+    for (i = 0; i < n; i++) {
+        glyph = fons__getGlyph(stash, font, codepoints[i], isize, iblur, blurType);
+        if (glyph != NULL) {
+            fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q, NULL, 0);
+            if (q.x0 < minx) minx = q.x0;
+            if (q.x1 > maxx) maxx = q.x1;
+            if (stash->params.flags & FONS_ZERO_TOPLEFT) {
+                if (q.y0 < miny) miny = q.y0;
+                if (q.y1 > maxy) maxy = q.y1;
+            } else {
+                if (q.y1 < miny) miny = q.y1;
+                if (q.y0 > maxy) maxy = q.y0;
+            }
+        }
+        prevGlyphIndex = glyph != NULL ? glyph->index : -1;
+    }
+
+    advance = x - startx;
+
+    // Align horizontally
+    if (state->align & FONS_ALIGN_LEFT) {
+        // empty
+    } else if (state->align & FONS_ALIGN_RIGHT) {
+        minx -= advance;
+        maxx -= advance;
+    } else if (state->align & FONS_ALIGN_CENTER) {
+        minx -= advance * 0.5f;
+        maxx -= advance * 0.5f;
+    }
+
+    if (bounds) {
+        bounds[0] = minx;
+        bounds[1] = miny;
+        bounds[2] = maxx;
+        bounds[3] = maxy;
+    }
+
+    return advance;
+}
+
+float fonsDrawText(FONScontext* stash,
+                   float x, float y,
+                   const char* str, const char* end,
+                   const char clear)
+{
+    if (stash == NULL) return x;
+
+    FONSstate* state = fons__getState(stash);
+    FONSglyph* glyph = NULL;
+    FONSquad q;
+    int prevGlyphIndex = -1;
+    short isize = (short)(state->size*10.0f);
+    short iblur = (short)state->blur;
+    float scale;
+    FONSfont* font;
+    int useShaping;
+    int invalid = 0;
+
+    if (state->font < 0 || state->font >= stash->nfonts) return x;
+    font = stash->fonts[state->font];
+    if (font->data == NULL) return x;
+
+    scale = fons__tt_getPixelHeightScale(&font->font, (float)isize/10.0f);
+
+    useShaping = font->font.shaper != NULL && fons__getState(stash)->useShaping;
+
+    y += fons__getVertAlign(stash, font, state->align, isize);
+
+    if(useShaping) {
+        FONSshaping* shaping = stash->shaping;
+
+        if(shaping) {
+            // a string checked by fonsTextDrawable is found in the shaping cache
+            if (!fons__hb_shape(stash, str, end, font, isize, &shaping->view)) {
+                return -1.f;
+            }
+            shaping->result = &shaping->view;
+
+            x = fons__drawShaped(stash, font, shaping->result, isize, x, y, clear, &invalid);
+
+            if(clear) {
+                fons__clearShaping(stash);
+            }
+        }
+    } else {
+        int first = stash->nverts;
+        int shift = 0;
+        float startx = x;
+        int i, n;
+
+        if (end == NULL)
+            end = str + strlen(str);
+
+        n = fons__decodeText(stash, str, end);
+        if (n < 0) return -1.f;
+
+        // Align horizontally. The quads are emitted from 0 and moved once the advance is known, quads that may be
+        // flushed before the string is drawn are placed from the measured advance instead. The atlas full callback
+        // can flush from fons__getGlyph through fonsExpandAtlas or fonsResetAtlas.
+        if (!(state->align & FONS_ALIGN_LEFT) && (state->align & (FONS_ALIGN_RIGHT | FONS_ALIGN_CENTER))) {
+            if (stash->params.pushQuad == NULL && stash->handleError == NULL && stash->nverts + 6*n <= FONS_VERTEX_COUNT) {
+                shift = 1;
+                x = 0.0f;
+            } else {
+                x += fons__getHorizAlign(state->align, fons__textBounds(stash, font, x,y, stash->codepoints, n, NULL));
+            }
+        }
+
+        for (i = 0; i < n; i++) {
+            glyph = fons__getGlyph(stash, font, stash->codepoints[i], isize, iblur, state->blurType);
+            if (glyph != NULL) {
+                fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q, NULL, 0);
+
+                if (stash->nverts+6 > FONS_VERTEX_COUNT)
+                    fons__flush(stash, clear);
+                fons__vertices(stash, q, state);
+            } else {
+                invalid |= 1;
+            }
+            prevGlyphIndex = glyph != NULL ? glyph->index : -1;
+        }
+        if (shift) {
+            startx += fons__getHorizAlign(state->align, x);
+            fons__moveQuads(stash, first, startx);
+            x += startx;
+        }
+        fons__flush(stash, clear);
+    }
+
+    if (invalid) {
+        fons__flush(stash, 1);
+        return -1.f;
+    }
+    return x;
+}
+
+#ifdef FONS_USE_HARFBUZZ
+
+// Strings of a batch missing from the shaping cache, job i shapes every njobs-th of them with shapers[i].
+struct FONShbBatch
+{
+    FONSshaping* shaping;
+    FONSfont* simple;	// Font of the simple strings, see fons__simpleRun.
+    int font;
+    short isize;
+    const char** strings;
+    const int* lengths;
+    const int* misses;
+    int nmisses;
+    int njobs;
+    FONShbFontShaper* shapers[FONS_MAX_THREADS];
+    FONSshapedRun** runs;
+};
+typedef struct FONShbBatch FONShbBatch;
+
+static void fons__hbBatchJob(void* arg, int job)
+{
+    FONShbBatch* batch = (FONShbBatch*)arg;
+    FONShbFontShaper* shaper = batch->shapers[job];
+    FONSshapedRun* run;
+    unsigned int glyphCount, simpleCount;
+    int k, i;
+
+    for (k = job; k < batch->nmisses; k += batch->njobs) {
+        i = batch->misses[k];
+        simpleCount = fons__simpleRun(batch->shaping, batch->simple, batch->strings[i], batch->lengths[i]);
+        if (simpleCount > 0)
+            glyphCount = simpleCount;
+        else
+            glyphCount = fons__hbShapeText(shaper, batch->shaping, batch->strings[i], batch->lengths[i], 0, batch->lengths[i],
+                                           batch->isize);
+        run = fons__allocRun(glyphCount);
+        if (run != NULL) {
+            if (simpleCount > 0)
+                fons__simpleShape(batch->simple, shaper->face, batch->strings[i], batch->lengths[i], 0, batch->lengths[i],
+                                  batch->isize, &run->res);
+            else
+                fons__hbStoreGlyphs(shaper, &run->res);
+            run->font = batch->font;
+            run->isize = batch->isize;
+            run->res.simple = simpleCount > 0;
+        }
+        batch->runs[i] = run;
+    }
+}
+
+#ifdef FONS_USE_THREADS
+// Shaper of batch job i. The faces of the worker shapers are opened on the calling thread,
+// FreeType only allows one thread at a time to do that.
+static FONShbFontShaper* fons__hbJobShaper(FONSfont* font, int i)
+{
+    FONShbFontShaper* shaper = (FONShbFontShaper*)font->font.shaper;
+    FT_Face face;
+
+    if (i == 0) return shaper;
+    if (shaper->workers[i] == NULL) {
+        if (fons__tt_newFace(font->data, font->dataSize, &face) != 0) return NULL;
+        shaper->workers[i] = fons__hbCreateShaper(face);
+        if (shaper->workers[i] == NULL) FT_Done_Face(face);
+    }
+    return shaper->workers[i];
+}
+#endif
+
+static int fons__hb_shapeBatch(FONScontext* stash, FONSfont* font, int fontIndex, short isize,
+                               const char** strings, const int* lengths, int count, FONSshapedRun** runs)
+{
+    FONSshaping* shaping = stash->shaping;
+    FONShbFontShaper* shaper = (FONShbFontShaper*)font->font.shaper;
+    FONShbBatch batch;
+    FONSshapingRes res;
+    unsigned int* hashes;
+    int* lens;
+    int* misses;
+    int i, k, nruns = 0;
+
+    hashes = (unsigned int*) malloc(count * (sizeof(unsigned int) + sizeof(int) * 2));
+    if (hashes == NULL) return 0;
+    lens = (int*)(hashes + count);
+    misses = lens + count;
+
+    // Cached strings are copied right away.
+    memset(&batch, 0, sizeof(batch));
+    for (i = 0; i < count; i++) {
+        lens[i] = lengths ? lengths[i] : (int)strlen(strings[i]);
+        hashes[i] = fons__hashShaping(strings[i], lens[i], isize);
+        runs[i] = NULL;
+        if (fons__shapingCacheFind(shaping, font, strings[i], lens[i], isize, hashes[i], &res)) {
+            shaping->cache.hits++;
+            runs[i] = fons__allocRun(res.glyphCount);
+            if (runs[i] != NULL) {
+                memcpy(runs[i] + 1, res.codepoints, fons__runGlyphBytes(res.glyphCount));
+                runs[i]->font = fontIndex;
+                runs[i]->isize = isize;
+                runs[i]->res.simple = res.simple;
+            }
+        } else {
+            shaping->cache.misses++;
+            misses[batch.nmisses++] = i;
+        }
+    }
+
+    // The jobs read the simple glyphs of the font.
+    if (!font->simpleReady)
+        fons__hbSimpleGlyphs(font);
+
+    batch.shaping = shaping;
+    batch.simple = font;
+    batch.font = fontIndex;
+    batch.isize = isize;
+    batch.strings = strings;
+    batch.lengths = lens;
+    batch.misses = misses;
+    batch.runs = runs;
+    batch.njobs = 1;
+    batch.shapers[0] = shaper;
+
+#ifdef FONS_USE_THREADS
+    FONSthreadPool* pool = batch.nmisses >= FONS_SHAPING_PARALLEL_STRINGS ? fons__getPool(stash) : NULL;
+    if (pool != NULL) {
+        batch.njobs = pool->nworkers + 1;
+        for (i = 1; i < batch.njobs; i++) {
+            batch.shapers[i] = fons__hbJobShaper(font, i);
+            if (batch.shapers[i] == NULL) {
+                batch.njobs = i;
+                break;
+            }
         }
-    } else {
-        int g;
-        unsigned int utf8state = 0;
+    }
+    if (batch.njobs > 1)
+        fons__poolFor(pool, fons__hbBatchJob, &batch, batch.njobs);
+    else
+#endif
+    fons__hbBatchJob(&batch, 0);
+
+    // The new results are added to the cache on the calling thread, once per string.
+    for (k = 0; k < batch.nmisses; k++) {
+        i = misses[k];
+        if (runs[i] == NULL) continue;
+        if (fons__shapingCacheFind(shaping, font, strings[i], lens[i], isize, hashes[i], &res)) continue;
+        if (fons__shapingCacheAdd(shaping, font, strings[i], lens[i], isize, hashes[i], runs[i]->res.glyphCount,
+                                  runs[i]->res.simple, &res))
+            memcpy(res.codepoints, runs[i] + 1, fons__runGlyphBytes(res.glyphCount));
+    }
 
-        if (end == NULL)
-            end = str + strlen(str);
+    for (i = 0; i < count; i++)
+        nruns += runs[i] != NULL;
+    free(hashes);
+    return nruns;
+}
 
-        for (; str != end; ++str) {
-            if (fons__decutf8(&utf8state, &codepoint, *(const unsigned char*)str))
-                continue;
+// Copies count glyphs of src from glyph s to glyph d of dst, moving the clusters from 'from' on by delta bytes.
+static void fons__copyGlyphs(FONSshapingRes* dst, unsigned int d, const FONSshapingRes* src, unsigned int s,
+                             unsigned int count, uint32_t from, int delta)
+{
+    unsigned int i;
 
-            if (codepoint == 0) {
-                return false;
-            }
+    memcpy(dst->codepoints + d, src->codepoints + s, count * sizeof(uint32_t));
+    memcpy(dst->advance + d*2, src->advance + s*2, count * sizeof(float) * 2);
+    memcpy(dst->offset + d*2, src->offset + s*2, count * sizeof(float) * 2);
+    for (i = 0; i < count; i++)
+        dst->clusters[d+i] = src->clusters[s+i] >= from ? src->clusters[s+i] + delta : src->clusters[s+i];
+}
 
-            g = fons__tt_getGlyphIndex(&font->font, codepoint, 0);
-            if (g == 0) {
-                return false;
-            }
+// Shapes the words around an edit of the string of a run and splices their glyphs into a copy of the run, see
+// fonsReshapeRun. Returns NULL when the edit can't be shaped on its own and the whole string is to be shaped.
+static FONSshapedRun* fons__hb_reshapeRun(FONScontext* stash, FONSfont* font, const FONSshapedRun* run,
+                                          const char* text, int len, int start, int removed, int inserted)
+{
+    FONSshaping* shaping = stash->shaping;
+    FONShbFontShaper* shaper = (FONShbFontShaper*)font->font.shaper;
+    const FONSshapingRes* old = &run->res;
+    FONSshapedRun* reshaped;
+    FONSshapingRes part;
+    unsigned int i, g0, g1, count, n = old->glyphCount;
+    int lo, hi, oldHi, oldLen, delta = inserted - removed, simple;
+
+    oldLen = len - delta;
+    if (n == 0 || old->clusters[0] >= (uint32_t)oldLen || old->clusters[n-1] >= (uint32_t)oldLen) return NULL;
+
+    // The edited words with the spaces around them, nothing is expected to be shaped across a space.
+    lo = start;
+    while (lo > 0 && text[lo-1] != ' ') lo--;
+    if (lo > 0) lo--;
+    hi = start + inserted;
+    while (hi < len && text[hi] != ' ') hi++;
+    if (hi < len) hi++;
+    oldHi = hi - delta;
+    if (lo == 0 && hi == len) return NULL;
+
+    // Clusters are monotonic so the glyphs of the words follow each other, they have to start and end clusters.
+    for (g0 = 0; g0 < n && (old->clusters[g0] < (uint32_t)lo || old->clusters[g0] >= (uint32_t)oldHi); g0++);
+    for (g1 = g0; g1 < n && old->clusters[g1] >= (uint32_t)lo && old->clusters[g1] < (uint32_t)oldHi; g1++);
+    if (g0 == g1) return NULL;
+    for (i = g1; i < n; i++) {
+        if (old->clusters[i] >= (uint32_t)lo && old->clusters[i] < (uint32_t)oldHi) return NULL;
+    }
+    if (old->clusters[g0] != (uint32_t)lo && old->clusters[g1-1] != (uint32_t)lo) return NULL;
+    if (oldHi < oldLen && !(g1 < n && old->clusters[g1] == (uint32_t)oldHi)
+            && !(g0 > 0 && old->clusters[g0-1] == (uint32_t)oldHi)) return NULL;
+
+    // Glyphs shaped with and without HarfBuzz aren't mixed.
+    simple = fons__simpleRun(shaping, font, text, len) > 0;
+    if (simple != old->simple) return NULL;
+    if (simple) {
+        count = fons__simpleRun(shaping, font, text + lo, hi - lo);
+    } else {
+        count = fons__hbShapeText(shaper, shaping, text, len, lo, hi - lo, run->isize);
+#if HB_VERSION_ATLEAST(1,5,0)
+        hb_glyph_info_t* glyphInfo = hb_buffer_get_glyph_infos(shaper->buffer, NULL);
+        for (i = 0; i < count; i++) {
+            if (glyphInfo[i].cluster == (uint32_t)lo
+                    && (hb_glyph_info_get_glyph_flags(&glyphInfo[i]) & HB_GLYPH_FLAG_UNSAFE_TO_BREAK))
+                return NULL;
         }
+#endif
     }
 
-    return true;
+    reshaped = fons__allocRun(n - (g1 - g0) + count);
+    if (reshaped == NULL) return NULL;
+    fons__copyGlyphs(&reshaped->res, 0, old, 0, g0, (uint32_t)oldHi, delta);
+    fons__copyGlyphs(&reshaped->res, g0 + count, old, g1, n - g1, (uint32_t)oldHi, delta);
+
+    part.glyphCount = count;
+    part.codepoints = reshaped->res.codepoints + g0;
+    part.advance = reshaped->res.advance + g0*2;
+    part.offset = reshaped->res.offset + g0*2;
+    part.clusters = reshaped->res.clusters + g0;
+    if (simple)
+        fons__simpleShape(font, shaper->face, text, len, lo, hi - lo, run->isize, &part);
+    else
+        fons__hbStoreGlyphs(shaper, &part);
+
+    reshaped->res.simple = simple;
+    reshaped->font = run->font;
+    reshaped->isize = run->isize;
+    return reshaped;
 }
 
-float fonsDrawText(FONScontext* stash,
-                   float x, float y,
-                   const char* str, const char* end,
-                   const char clear)
+#else
+
+static int fons__hb_shapeBatch(FONScontext* stash, FONSfont* font, int fontIndex, short isize,
+                               const char** strings, const int* lengths, int count, FONSshapedRun** runs)
 {
-    if (stash == NULL) return x;
+    FONS_NOTUSED(stash);
+    FONS_NOTUSED(font);
+    FONS_NOTUSED(fontIndex);
+    FONS_NOTUSED(isize);
+    FONS_NOTUSED(strings);
+    FONS_NOTUSED(lengths);
+    FONS_NOTUSED(count);
+    FONS_NOTUSED(runs);
+    return 0;
+}
 
-    FONSstate* state = fons__getState(stash);
-    unsigned int codepoint;
-    unsigned int utf8state = 0;
-    FONSglyph* glyph = NULL;
-    FONSquad q;
-    int prevGlyphIndex = -1;
-    short isize = (short)(state->size*10.0f);
-    short iblur = (short)state->blur;
-    float scale;
+static FONSshapedRun* fons__hb_reshapeRun(FONScontext* stash, FONSfont* font, const FONSshapedRun* run,
+                                          const char* text, int len, int start, int removed, int inserted)
+{
+    FONS_NOTUSED(stash);
+    FONS_NOTUSED(font);
+    FONS_NOTUSED(run);
+    FONS_NOTUSED(text);
+    FONS_NOTUSED(len);
+    FONS_NOTUSED(start);
+    FONS_NOTUSED(removed);
+    FONS_NOTUSED(inserted);
+    return NULL;
+}
+
+#endif // FONS_USE_HARFBUZZ
+
+// Copies a string shaped with the current state in mem, or in a new allocation when mem is NULL.
+static FONSshapedRun* fons__shapeRun(FONScontext* stash, const char* str, const char* end, void* mem, int memSize, int* needed)
+{
+    FONSstate* state;
     FONSfont* font;
-    int useShaping;
-    int invalid = 0;
+    FONSshapingRes res;
+    FONSshapedRun* run;
+    short isize;
+    int size;
 
-    if (state->font < 0 || state->font >= stash->nfonts) return x;
+    if (needed) *needed = 0;
+    if (stash == NULL || stash->shaping == NULL) return NULL;
+    state = fons__getState(stash);
+    if (state->font < 0 || state->font >= stash->nfonts) return NULL;
     font = stash->fonts[state->font];
-    if (font->data == NULL) return x;
+    if (font->data == NULL || font->font.shaper == NULL) return NULL;
 
-    scale = fons__tt_getPixelHeightScale(&font->font, (float)isize/10.0f);
+    isize = (short)(state->size*10.0f);
+    if (!fons__hb_shape(stash, str, end, font, isize, &res)) return NULL;
+
+    size = (int)fons__runGlyphBytes(res.glyphCount);
+    if (mem) {
+        int total = (int)((sizeof(FONSshapedRun) + size + sizeof(void*) - 1) & ~(sizeof(void*) - 1));
+        if (needed) *needed = total;
+        if (total > memSize) return NULL;
+        run = (FONSshapedRun*)mem;
+        fons__shapingView(&run->res, (unsigned char*)(run + 1), res.glyphCount);
+    } else {
+        run = fons__allocRun(res.glyphCount);
+        if (run == NULL) return NULL;
+    }
+    memcpy(run + 1, res.codepoints, size);
+    run->font = state->font;
+    run->isize = isize;
+    run->res.simple = res.simple;
+    return run;
+}
 
-    useShaping = font->font.shaper != NULL && fons__getState(stash)->useShaping;
+FONSshapedRun* fonsShapeRun(FONScontext* stash, const char* str, const char* end)
+{
+    return fons__shapeRun(stash, str, end, NULL, 0, NULL);
+}
 
-    y += fons__getVertAlign(stash, font, state->align, isize);
+int fonsShapeBatch(FONScontext* stash, const char** strings, const int* lengths, int count, FONSshapedRun** runs)
+{
+    FONSstate* state;
+    FONSfont* font;
+    int i;
 
-    if(useShaping) {
-        FONSshaping* shaping = stash->shaping;
+    for (i = 0; i < count; i++)
+        runs[i] = NULL;
+    if (stash == NULL || stash->shaping == NULL || count <= 0) return 0;
+    state = fons__getState(stash);
+    if (state->font < 0 || state->font >= stash->nfonts) return 0;
+    font = stash->fonts[state->font];
+    if (font->data == NULL || font->font.shaper == NULL) return 0;
 
-        if(shaping) {
-            unsigned int i, j;
+    return fons__hb_shapeBatch(stash, font, state->font, (short)(state->size*10.0f), strings, lengths, count, runs);
+}
 
-            // shaping result hasn't been cached
-            if (!shaping->result) {
-                shaping->result = (FONSshapingRes*) malloc(sizeof(FONSshapingRes));
+FONSshapedRun* fonsReshapeRun(FONScontext* stash, const FONSshapedRun* run, const char* str, const char* end,
+                              int start, int removed, int inserted)
+{
+    FONSstate* state;
+    FONSshapedRun* reshaped;
+    int len;
+
+    if (stash == NULL || stash->shaping == NULL || run == NULL) return NULL;
+    state = fons__getState(stash);
+    len = end ? (int)(end - str) : (int)strlen(str);
+
+    if (state->font == run->font && (short)(state->size*10.0f) == run->isize && run->font < stash->nfonts
+            && stash->fonts[run->font]->font.shaper != NULL
+            && start >= 0 && removed >= 0 && inserted >= 0 && start + inserted <= len) {
+        reshaped = fons__hb_reshapeRun(stash, stash->fonts[run->font], run, str, len, start, removed, inserted);
+        if (reshaped != NULL) return reshaped;
+    }
+    return fons__shapeRun(stash, str, str + len, NULL, 0, NULL);
+}
 
-                // harfbuzz needs this to be called to be able to perform shaping
-                fons__tt_setPixelSize(&font->font, (float)isize/10.0f);
+FONSshapedRun* fonsShapeRunInto(FONScontext* stash, const char* str, const char* end, void* mem, int size, int* needed)
+{
+    if (mem == NULL) {
+        if (needed) *needed = 0;
+        return NULL;
+    }
+    return fons__shapeRun(stash, str, end, mem, size, needed);
+}
 
-                fons__hb_shape(stash, str, font);
-            }
+float fonsDrawRun(FONScontext* stash, float x, float y, const FONSshapedRun* run, const char clear)
+{
+    if (stash == NULL || run == NULL) return x;
 
-            for (i = 0, j = 0; i < shaping->result->glyphCount; i++, j+=2) {
-                shaping->it = j;
-                codepoint = shaping->result->codepoints[i];
-                if (codepoint == 0) {
-                    continue;
-                }
-                glyph = fons__getGlyph(stash, font, codepoint, isize, iblur, state->blurType);
+    FONSstate* state = fons__getState(stash);
+    FONSfont* font;
+    int invalid = 0;
 
-                if (glyph != NULL) {
-                    fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q, useShaping);
+    if (run->font < 0 || run->font >= stash->nfonts) return x;
+    font = stash->fonts[run->font];
+    if (font->data == NULL) return x;
 
-                    if (stash->nverts+6 > FONS_VERTEX_COUNT)
-                        fons__flush(stash, clear);
+    y += fons__getVertAlign(stash, font, state->align, run->isize);
+    x = fons__drawShaped(stash, font, &run->res, run->isize, x, y, clear, &invalid);
 
-                    fons__vertices(stash, q, state);
-                } else {
-                    invalid |= 1;
-                }
-                prevGlyphIndex = glyph != NULL ? glyph->index : -1;
-            }
+    if (invalid) {
+        fons__flush(stash, 1);
+        return -1.f;
+    }
+    return x;
+}
 
-            fons__flush(stash, clear);
+float fonsRunBounds(FONScontext* stash, float x, float y, const FONSshapedRun* run, float* bounds)
+{
+    if (stash == NULL || run == NULL) return 0;
 
-            if(clear) {
-                fons__clearShaping(stash);
-            }
-        }
-    } else {
-        float width;
+    FONSstate* state = fons__getState(stash);
+    FONSquad q;
+    FONSglyph* glyph;
+    FONSfont* font;
+    int prevGlyphIndex = -1;
+    short iblur = (short)state->blur;
+    float scale, startx;
+    float minx, miny, maxx, maxy;
+    unsigned int i, j;
 
-        if (end == NULL)
-            end = str + strlen(str);
+    if (run->font < 0 || run->font >= stash->nfonts) return 0;
+    font = stash->fonts[run->font];
+    if (font->data == NULL) return 0;
 
-        // Align horizontally
-        if (state->align & FONS_ALIGN_LEFT) {
-            // empty
-        } else if (state->align & FONS_ALIGN_RIGHT) {
-            width = fonsTextBounds(stash, x,y, str, end, NULL);
-            x -= width;
-        } else if (state->align & FONS_ALIGN_CENTER) {
-            width = fonsTextBounds(stash, x,y, str, end, NULL);
-            x -= width * 0.5f;
-        }
+    scale = fons__tt_getPixelHeightScale(&font->font, (float)run->isize/10.0f);
 
-        for (; str != end; ++str) {
-            if (fons__decutf8(&utf8state, &codepoint, *(const unsigned char*)str))
-                continue;
-            glyph = fons__getGlyph(stash, font, codepoint, isize, iblur, state->blurType);
-            if (glyph != NULL) {
-                fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q, useShaping);
+    // Align vertically.
+    y += fons__getVertAlign(stash, font, state->align, run->isize);
 
-                if (stash->nverts+6 > FONS_VERTEX_COUNT)
-                    fons__flush(stash, clear);
-                fons__vertices(stash, q, state);
-            } else {
-                invalid |= 1;
-            }
-            prevGlyphIndex = glyph != NULL ? glyph->index : -1;
+    minx = maxx = x;
+    miny = maxy = y;
+    startx = x;
+
+    for (i = 0, j = 0; i < run->res.glyphCount; i++, j+=2) {
+        if (run->res.codepoints[i] == 0) {
+            continue;
         }
-        fons__flush(stash, clear);
+        glyph = fons__getGlyph(stash, font, run->res.codepoints[i] | FONS_GLYPH_INDEX, run->isize, iblur, state->blurType);
+        if (glyph != NULL) {
+            fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q, &run->res, j);
+            minx = fons__minf(minx, fons__minf(q.x0, q.x1));
+            maxx = fons__maxf(maxx, fons__maxf(q.x0, q.x1));
+            miny = fons__minf(miny, fons__minf(q.y0, q.y1));
+            maxy = fons__maxf(maxy, fons__maxf(q.y0, q.y1));
+        }
+        prevGlyphIndex = glyph != NULL ? glyph->index : -1;
     }
 
-    if (invalid) {
-        fons__flush(stash, 1);
-        return -1.f;
+    // Align horizontally
+    minx += fons__getHorizAlign(state->align, x - startx);
+    maxx += fons__getHorizAlign(state->align, x - startx);
+
+    if (bounds) {
+        bounds[0] = minx;
+        bounds[1] = miny;
+        bounds[2] = maxx;
+        bounds[3] = maxy;
     }
-    return x;
+    return x - startx;
+}
+
+int fonsRunGlyphCount(const FONSshapedRun* run)
+{
+    return run != NULL ? (int)run->res.glyphCount : 0;
+}
+
+void fonsFreeRun(FONSshapedRun* run)
+{
+    free(run);
 }
 
 int fonsTextIterInit(FONScontext* stash, FONStextIter* iter,
@@ -1861,7 +4855,7 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, FONSquad* quad)
         iter->y = iter->nexty;
         glyph = fons__getGlyph(stash, iter->font, iter->codepoint, iter->isize, iter->iblur, iter->blurType);
         if (glyph != NULL)
-            fons__getQuad(stash, iter->font, iter->prevGlyphIndex, glyph, iter->scale, iter->spacing, &iter->nextx, &iter->nexty, quad, 0 /* TODO */);
+            fons__getQuad(stash, iter->font, iter->prevGlyphIndex, glyph, iter->scale, iter->spacing, &iter->nextx, &iter->nexty, quad, NULL, 0);
         iter->prevGlyphIndex = glyph != NULL ? glyph->index : -1;
         break;
     }
@@ -1878,75 +4872,20 @@ float fonsTextBounds(FONScontext* stash,
     if (stash == NULL) return 0;
 
     FONSstate* state = fons__getState(stash);
-    unsigned int codepoint;
-    unsigned int utf8state = 0;
-    FONSquad q;
-    FONSglyph* glyph = NULL;
-    int prevGlyphIndex = -1;
-    short isize = (short)(state->size*10.0f);
-    short iblur = (short)state->blur;
-    int blurType = state->blurType;
-    float scale;
     FONSfont* font;
-    float startx, advance;
-    float minx, miny, maxx, maxy;
+    int n;
 
     if (state->font < 0 || state->font >= stash->nfonts) return 0;
     font = stash->fonts[state->font];
     if (font->data == NULL) return 0;
 
-    scale = fons__tt_getPixelHeightScale(&font->font, (float)isize/10.0f);
-
-    // Align vertically.
-    y += fons__getVertAlign(stash, font, state->align, isize);
-
-    minx = maxx = x;
-    miny = maxy = y;
-    startx = x;
-
     if (end == NULL)
         end = str + strlen(str);
 
-    for (; str != end; ++str) {
-        if (fons__decutf8(&utf8state, &codepoint, *(const unsigned char*)str))
-            continue;
-        glyph = fons__getGlyph(stash, font, codepoint, isize, iblur, blurType);
-        if (glyph != NULL) {
-            fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q, 0 /* TODO */);
-            if (q.x0 < minx) minx = q.x0;
-            if (q.x1 > maxx) maxx = q.x1;
-            if (stash->params.flags & FONS_ZERO_TOPLEFT) {
-                if (q.y0 < miny) miny = q.y0;
-                if (q.y1 > maxy) maxy = q.y1;
-            } else {
-                if (q.y1 < miny) miny = q.y1;
-                if (q.y0 > maxy) maxy = q.y0;
-            }
-        }
-        prevGlyphIndex = glyph != NULL ? glyph->index : -1;
-    }
-
-    advance = x - startx;
-
-    // Align horizontally
-    if (state->align & FONS_ALIGN_LEFT) {
-        // empty
-    } else if (state->align & FONS_ALIGN_RIGHT) {
-        minx -= advance;
-        maxx -= advance;
-    } else if (state->align & FONS_ALIGN_CENTER) {
-        minx -= advance * 0.5f;
-        maxx -= advance * 0.5f;
-    }
-
-    if (bounds) {
-        bounds[0] = minx;
-        bounds[1] = miny;
-        bounds[2] = maxx;
-        bounds[3] = maxy;
-    }
+    n = fons__decodeText(stash, str, end);
+    if (n < 0) return 0;
 
-    return advance;
+    return fons__textBounds(stash, font, x, y, stash->codepoints, n, bounds);
 }
 
 void fonsVertMetrics(FONScontext* stash,
@@ -2021,6 +4960,32 @@ int fonsValidateTexture(FONScontext* stash, int* dirty)
     return 0;
 }
 
+const unsigned char* fonsGetTextureDataRGB(FONScontext* stash, int* width, int* height)
+{
+    if (width != NULL)
+        *width = stash->params.width;
+    if (height != NULL)
+        *height = stash->params.height;
+    return stash->texDataRGB;
+}
+
+int fonsValidateTextureRGB(FONScontext* stash, int* dirty)
+{
+    if (stash->dirtyRectRGB[0] < stash->dirtyRectRGB[2] && stash->dirtyRectRGB[1] < stash->dirtyRectRGB[3]) {
+        dirty[0] = stash->dirtyRectRGB[0];
+        dirty[1] = stash->dirtyRectRGB[1];
+        dirty[2] = stash->dirtyRectRGB[2];
+        dirty[3] = stash->dirtyRectRGB[3];
+        // Reset dirty rect
+        stash->dirtyRectRGB[0] = stash->params.width;
+        stash->dirtyRectRGB[1] = stash->params.height;
+        stash->dirtyRectRGB[2] = 0;
+        stash->dirtyRectRGB[3] = 0;
+        return 1;
+    }
+    return 0;
+}
+
 void fonsDeleteInternal(FONScontext* stash)
 {
     int i;
@@ -2036,7 +5001,16 @@ void fonsDeleteInternal(FONScontext* stash)
     if (stash->atlas) fons__deleteAtlas(stash->atlas);
     if (stash->fonts) free(stash->fonts);
     if (stash->texData) free(stash->texData);
+    if (stash->atlasRGB) fons__deleteAtlas(stash->atlasRGB);
+    if (stash->texDataRGB) free(stash->texDataRGB);
+    if (stash->outline.pts) free(stash->outline.pts);
+    if (stash->outline.smooth) free(stash->outline.smooth);
+    if (stash->outline.contours) free(stash->outline.contours);
     if (stash->scratch) free(stash->scratch);
+    if (stash->codepoints) free(stash->codepoints);
+#ifdef FONS_USE_THREADS
+    fons__deletePool(stash->pool);
+#endif
     free(stash);
 }
 
@@ -2054,10 +5028,35 @@ void fonsGetAtlasSize(FONScontext* stash, int* width, int* height)
     *height = stash->params.height;
 }
 
+void fonsSetSDFEngine(FONScontext* stash, int engine)
+{
+    if (stash == NULL) return;
+    stash->sdfEngine = engine;
+}
+
+void fonsSetSDFDownsample(FONScontext* stash, int factor)
+{
+    if (stash == NULL) return;
+    stash->sdfDownsample = fons__maxi(1, fons__mini(factor, 4));
+}
+
+void fonsSetSDFSpread(FONScontext* stash, float spread)
+{
+    if (stash == NULL) return;
+    stash->sdfSpread = (short)fons__maxi(0, fons__mini((int)spread, 20));
+}
+
+float fonsGetSDFSpread(FONScontext* stash)
+{
+    if (stash == NULL) return 0.0f;
+    return (float)stash->sdfSpread;
+}
+
 int fonsExpandAtlas(FONScontext* stash, int width, int height, const char clear)
 {
     int i, maxy = 0;
     unsigned char* data = NULL;
+    unsigned char* dataRGB = NULL;
     if (stash == NULL) return 0;
 
     width = fons__maxi(width, stash->params.width);
@@ -2066,18 +5065,30 @@ int fonsExpandAtlas(FONScontext* stash, int width, int height, const char clear)
     if (width == stash->params.width && height == stash->params.height)
         return 1;
 
+    // Allocate both pages first, the context is left as is when one fails.
+    data = (unsigned char*)malloc(width * height);
+    if (data == NULL)
+        return 0;
+    if (stash->texDataRGB != NULL) {
+        dataRGB = (unsigned char*)malloc(width * height * 3);
+        if (dataRGB == NULL) {
+            free(data);
+            return 0;
+        }
+    }
+
     // Flush pending glyphs.
     fons__flush(stash, clear);
 
     // Create new texture
     if (stash->params.renderResize != NULL) {
-        if (stash->params.renderResize(stash->params.userPtr, width, height) == 0)
+        if (stash->params.renderResize(stash->params.userPtr, width, height) == 0) {
+            free(data);
+            free(dataRGB);
             return 0;
+        }
     }
     // Copy old texture data over.
-    data = (unsigned char*)malloc(width * height);
-    if (data == NULL)
-        return 0;
     for (i = 0; i < stash->params.height; i++) {
         unsigned char* dst = &data[i*width];
         unsigned char* src = &stash->texData[i*stash->params.width];
@@ -2091,6 +5102,32 @@ int fonsExpandAtlas(FONScontext* stash, int width, int height, const char clear)
     free(stash->texData);
     stash->texData = data;
 
+    // Same for the RGB page, if in use.
+    if (dataRGB != NULL) {
+        for (i = 0; i < stash->params.height; i++) {
+            unsigned char* dst = &dataRGB[i*width*3];
+            unsigned char* src = &stash->texDataRGB[i*stash->params.width*3];
+            memcpy(dst, src, stash->params.width*3);
+            if (width > stash->params.width)
+                memset(dst+stash->params.width*3, 0, (width - stash->params.width)*3);
+        }
+        if (height > stash->params.height)
+            memset(&dataRGB[stash->params.height * width * 3], 0, (height - stash->params.height) * width * 3);
+
+        free(stash->texDataRGB);
+        stash->texDataRGB = dataRGB;
+
+        fons__atlasExpand(stash->atlasRGB, width, height);
+        maxy = 0;
+        for (i = 0; i < stash->atlasRGB->nnodes; i++)
+            maxy = fons__maxi(maxy, stash->atlasRGB->nodes[i].y);
+        stash->dirtyRectRGB[0] = 0;
+        stash->dirtyRectRGB[1] = 0;
+        stash->dirtyRectRGB[2] = stash->params.width;
+        stash->dirtyRectRGB[3] = maxy;
+        maxy = 0;
+    }
+
     // Increase atlas size
     fons__atlasExpand(stash->atlas, width, height);
 
@@ -2138,12 +5175,25 @@ int fonsResetAtlas(FONScontext* stash, int width, int height, const char clear)
     stash->dirtyRect[2] = 0;
     stash->dirtyRect[3] = 0;
 
-    // Reset cached glyphs
+    // Reset the RGB page, if in use.
+    if (stash->texDataRGB != NULL) {
+        fons__atlasReset(stash->atlasRGB, width, height);
+        stash->texDataRGB = (unsigned char*)realloc(stash->texDataRGB, width * height * 3);
+        if (stash->texDataRGB == NULL) return 0;
+        memset(stash->texDataRGB, 0, width * height * 3);
+        stash->dirtyRectRGB[0] = width;
+        stash->dirtyRectRGB[1] = height;
+        stash->dirtyRectRGB[2] = 0;
+        stash->dirtyRectRGB[3] = 0;
+    }
+
+    // Reset cached glyphs and release their outlines
     for (i = 0; i < stash->nfonts; i++) {
         FONSfont* font = stash->fonts[i];
         font->nglyphs = 0;
         for (j = 0; j < FONS_HASH_LUT_SIZE; j++)
             font->lut[j] = -1;
+        fons__freeOutlineCache(&font->outlines);
     }
 
     stash->params.width = width;
@@ -38,6 +38,8 @@ struct GLFONSparams {
     bool useGLBackend;
     void (*updateBuffer)(void* usrPtr, GLintptr offset, GLsizei size, float* newData, void* owner);
     void (*updateAtlas)(void* usrPtr, unsigned int xoff, unsigned int yoff, unsigned int width, unsigned int height, const unsigned int* pixels);
+    // RGB page of FONS_EFFECT_MSDF glyphs, three bytes per pixel, may be NULL without that effect.
+    void (*updateAtlasRGB)(void* usrPtr, unsigned int xoff, unsigned int yoff, unsigned int width, unsigned int height, const unsigned char* pixels);
 };
 
 enum {
@@ -45,6 +47,11 @@ enum {
     GLFONS_INVALID
 };
 
+enum {
+    GLFONS_PAGE_ALPHA,
+    GLFONS_PAGE_RGB
+};
+
 // GLFONTSTASH API
 FONScontext* glfonsCreate(int width, int height, int flags, GLFONSparams glParams, void* userPtr);
 void glfonsDelete(FONScontext* ctx);
@@ -67,6 +74,11 @@ void glfonsProjection(FONScontext* ctx, float* projectionMatrix);
 void glfonsUpdateBuffer(FONScontext* ctx, void* owner = nullptr);
 void glfonsDraw(FONScontext* ctx);
 void glfonsSetColor(FONScontext* ctx, unsigned int color);
+// Draws the bound buffer as an effect layer of distance field glyphs rasterized with a shared spread (fonsSetSDFSpread):
+// the edge is moved out by 'dilate' pixels (outline, halo), smoothed over 'softness' pixels (glow) and the
+// glyphs are offset by dx, dy pixels (shadow). The same text in several buffers shares the atlas entries.
+// FONS_EFFECT_MSDF glyphs take the same effect, the pixels are converted with the spread so their blur should match it.
+void glfonsSetEffect(FONScontext* ctx, float dilate, float softness, float dx, float dy);
 unsigned int glfonsRGBA(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
 
 #endif
@@ -115,12 +127,21 @@ struct GLFONSVertexLayout {
     std::vector<GLFONSvertexAttrib> attributes;
 };
 
+// Vertices of a buffer sampling the same atlas page.
+struct GLFONSrange {
+    GLint first;
+    GLsizei count;
+    int page;
+};
+
 struct GLFONSbuffer {
     fsuint id;
     fsuint textIdCount;
     GLuint vbo;
     unsigned int nVerts, color = 0xffffff;
+    float effect[4] = {0.0f, 0.0f, 0.0f, 0.0f};
     std::vector<float> interleavedArray;
+    std::vector<GLFONSrange> ranges;
     std::unordered_map<fsuint, GLFONSstash*> stashes;
     GLintptr dirtyOffset;
     GLsizei dirtySize;
@@ -133,7 +154,9 @@ struct GLFONScontext {
     GLFONSparams params;
     int atlasRes[2];
     GLuint atlas;
+    GLuint atlasRGB;
     GLuint program;
+    GLuint programMSDF;
     fsuint bufferCount;
     fsuint boundBuffer;
     float screenSize[2];
@@ -165,6 +188,18 @@ static void glfons__renderUpdate(void* userPtr, int* rect, const unsigned char*
     gl->params.updateAtlas(gl->userPtr, 0, rect[1], gl->atlasRes[0], h, reinterpret_cast<const unsigned int*>(subdata));
 }
 
+static void glfons__renderUpdateRGB(void* userPtr, int* rect, const unsigned char* data) {
+    GLFONScontext* gl = (GLFONScontext*)userPtr;
+
+    if(gl->params.updateAtlasRGB == NULL) {
+        return;
+    }
+
+    int h = rect[3] - rect[1];
+    const unsigned char* subdata = data + rect[1] * gl->atlasRes[0] * 3;
+    gl->params.updateAtlasRGB(gl->userPtr, 0, rect[1], gl->atlasRes[0], h, subdata);
+}
+
 static void glfons__renderDraw(void* userPtr, const float* verts, const float* tcoords, const unsigned int* colors, int nverts) {
     // called by fontstash, but has nothing to do
 }
@@ -252,33 +287,50 @@ void glfons__disableVertexLayout(GLFONScontext* gl) {
     }
 }
 
-void glfons__initShaders(GLFONScontext* gl) {
+// Links the vertex shader with a fragment shader, the attributes are bound to the same locations in every program.
+GLuint glfons__linkProgram(GLFONScontext* gl, const GLchar* fragmentSrc) {
     GLuint program = glCreateProgram();
     GLuint vertex = glfons__compileShader(glfs::vertexShaderSrc, GL_VERTEX_SHADER);
-    GLuint fragment = glfons__compileShader(glfs::sdfFragShaderSrc, GL_FRAGMENT_SHADER);
+    GLuint fragment = glfons__compileShader(fragmentSrc, GL_FRAGMENT_SHADER);
 
     GLFONS_GL_CHECK(glAttachShader(program, vertex));
     GLFONS_GL_CHECK(glAttachShader(program, fragment));
+
+    for(size_t i = 0; i < gl->layout.attributes.size(); ++i) {
+        GLFONS_GL_CHECK(glBindAttribLocation(program, i, gl->layout.attributes[i].name.c_str()));
+    }
+
     GLFONS_GL_CHECK(glLinkProgram(program));
 
     glDeleteShader(vertex);
     glDeleteShader(fragment);
-    gl->program = program;
 
+    GLFONS_GL_CHECK(glUseProgram(program));
+    GLFONS_GL_CHECK(glUniform1i(glGetUniformLocation(program, "u_tex"), ATLAS_TEXTURE_SLOT));
+
+    return program;
+}
+
+void glfons__initShaders(GLFONScontext* gl) {
     GLuint boundProgram;
     glGetIntegerv(GL_CURRENT_PROGRAM, (GLint*) &boundProgram);
-    GLFONS_GL_CHECK(glUseProgram(program));
-    GLFONS_GL_CHECK(glUniform1i(glGetUniformLocation(gl->program, "u_tex"), ATLAS_TEXTURE_SLOT));
-    glfons__initVertexLayout(gl, program);
+
+    glfons__createVertexLayout(gl);
+    gl->program = glfons__linkProgram(gl, glfs::sdfFragShaderSrc);
+    gl->programMSDF = glfons__linkProgram(gl, glfs::msdfFragShaderSrc);
+    glfons__initVertexLayout(gl, gl->program);
+
     glUseProgram(boundProgram);
 }
 
-void glfons__bindUniforms(GLFONScontext* gl, GLFONSbuffer* buffer) {
+void glfons__bindUniforms(GLuint program, GLFONSbuffer* buffer) {
     float r = (buffer->color & 0xff) / 255.0;
     float g = (buffer->color >> 8 & 0xff) / 255.0;
     float b = (buffer->color >> 16 & 0xff) / 255.0;
 
-    GLFONS_GL_CHECK(glUniform3f(glGetUniformLocation(gl->program, "u_color"), r, g, b));
+    GLFONS_GL_CHECK(glUniform3f(glGetUniformLocation(program, "u_color"), r, g, b));
+    GLFONS_GL_CHECK(glUniform2f(glGetUniformLocation(program, "u_effect"), buffer->effect[0], buffer->effect[1]));
+    GLFONS_GL_CHECK(glUniform2f(glGetUniformLocation(program, "u_offset"), buffer->effect[2], buffer->effect[3]));
 }
 
 void glfons__updateProjection(GLFONScontext* gl) {
@@ -318,20 +370,43 @@ void glfons__draw(GLFONScontext* gl, bool bindAtlas) {
 
     if(gl->resolutionDirty) {
         glfons__updateProjection(gl);
+        GLFONS_GL_CHECK(glUseProgram(gl->programMSDF));
+        GLFONS_GL_CHECK(glUniformMatrix4fv(glGetUniformLocation(gl->programMSDF, "u_proj"), 1, GL_FALSE, gl->projectionMatrix));
+        GLFONS_GL_CHECK(glUseProgram(gl->program));
         GLFONS_GL_CHECK(glUniformMatrix4fv(glGetUniformLocation(gl->program, "u_proj"), 1, GL_FALSE, gl->projectionMatrix));
     }
 
+    glActiveTexture(GL_TEXTURE0 + ATLAS_TEXTURE_SLOT);
     if(bindAtlas) {
-        glActiveTexture(GL_TEXTURE0 + ATLAS_TEXTURE_SLOT);
         GLFONS_GL_CHECK(glBindTexture(GL_TEXTURE_2D, gl->atlas));
     }
 
+    GLuint program = gl->program;
+    GLuint texture = gl->atlas;
+
     for(auto& pair : gl->buffers) {
         GLFONSbuffer* buffer = pair.second;
         GLFONS_GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, buffer->vbo));
         glfons__enableVertexLayout(gl);
-        glfons__bindUniforms(gl, buffer);
-        GLFONS_GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, buffer->nVerts));
+
+        // MSDF glyphs sample the RGB page with their own program
+        for(auto& range : buffer->ranges) {
+            GLuint rangeProgram = range.page == GLFONS_PAGE_RGB ? gl->programMSDF : gl->program;
+            GLuint rangeTexture = range.page == GLFONS_PAGE_RGB ? gl->atlasRGB : gl->atlas;
+
+            if(rangeProgram != program) {
+                GLFONS_GL_CHECK(glUseProgram(rangeProgram));
+                program = rangeProgram;
+            }
+            if(rangeTexture != texture) {
+                GLFONS_GL_CHECK(glBindTexture(GL_TEXTURE_2D, rangeTexture));
+                texture = rangeTexture;
+            }
+
+            glfons__bindUniforms(program, buffer);
+            GLFONS_GL_CHECK(glDrawArrays(GL_TRIANGLES, range.first, range.count));
+        }
+
         glfons__disableVertexLayout(gl);
     }
 }
@@ -383,6 +458,36 @@ void glfons__udpateAtas(void* usrPtr, unsigned int xoff, unsigned int yoff,
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void glfons__createAtlasRGB(GLFONScontext* gl, unsigned int width, unsigned int height) {
+    glActiveTexture(GL_TEXTURE0 + ATLAS_TEXTURE_SLOT);
+    glGenTextures(1, &gl->atlasRGB);
+    GLFONS_GL_CHECK(glBindTexture(GL_TEXTURE_2D, gl->atlasRGB));
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// The RGB texture is created with the first FONS_EFFECT_MSDF glyph.
+void glfons__updateAtlasRGB(void* usrPtr, unsigned int xoff, unsigned int yoff,
+                            unsigned int width, unsigned int height, const unsigned char* pixels) {
+    GLFONScontext* gl = (GLFONScontext*) usrPtr;
+
+    if(gl->atlasRGB == 0) {
+        glfons__createAtlasRGB(gl, gl->atlasRes[0], gl->atlasRes[1]);
+    }
+
+    GLint unpackAlignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+
+    glActiveTexture(GL_TEXTURE0 + ATLAS_TEXTURE_SLOT);
+    GLFONS_GL_CHECK(glBindTexture(GL_TEXTURE_2D, gl->atlasRGB));
+    // rows of three bytes per pixel aren't 4-byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, xoff, yoff, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 void glfonsSetColor(FONScontext* ctx, unsigned int color) {
     GLFONScontext* gl = (GLFONScontext*) ctx->params.userPtr;
     GLFONSbuffer* buffer = glfons__bufferBound(gl);
@@ -395,6 +500,25 @@ void glfonsSetColor(FONScontext* ctx, unsigned int color) {
     buffer->color = color;
 }
 
+void glfonsSetEffect(FONScontext* ctx, float dilate, float softness, float dx, float dy) {
+    GLFONScontext* gl = (GLFONScontext*) ctx->params.userPtr;
+    GLFONSbuffer* buffer = glfons__bufferBound(gl);
+
+    if(!gl->params.useGLBackend) {
+        // should be directly sent to shader from own gl-backend
+        return;
+    }
+
+    // the field goes from 1 to 0 over twice the spread, convert pixels to field units
+    float spread = fonsGetSDFSpread(ctx);
+    float scale = spread > 0.0 ? 0.5 / spread : 0.0;
+
+    buffer->effect[0] = dilate * scale;
+    buffer->effect[1] = softness * scale;
+    buffer->effect[2] = dx;
+    buffer->effect[3] = dy;
+}
+
 void glfonsGenText(FONScontext* ctx, unsigned int nb, fsuint* textId) {
     GLFONScontext* gl = (GLFONScontext*) ctx->params.userPtr;
     GLFONSbuffer* buffer = glfons__bufferBound(gl);
@@ -422,6 +546,15 @@ int glfonsRasterize(FONScontext* ctx, fsuint textId, const char* s, unsigned int
     int oldSize = buffer->interleavedArray.size();
     buffer->interleavedArray.resize(oldSize + gl->layout.nbComponents * ctx->nverts, 0);
 
+    // all glyphs of a text are in the same atlas page
+    int page = fons__getState(ctx)->blurType == FONS_EFFECT_MSDF ? GLFONS_PAGE_RGB : GLFONS_PAGE_ALPHA;
+
+    if(!buffer->ranges.empty() && buffer->ranges.back().page == page) {
+        buffer->ranges.back().count += ctx->nverts;
+    } else if(ctx->nverts > 0) {
+        buffer->ranges.push_back({(GLint)buffer->nVerts, ctx->nverts, page});
+    }
+
     float inf = std::numeric_limits<float>::infinity();
     float x0 = inf, x1 = -inf, y0 = inf, y1 = -inf;
 
@@ -451,24 +584,13 @@ int glfonsRasterize(FONScontext* ctx, fsuint textId, const char* s, unsigned int
 
     stash->length = length - 6;
 
-    if(ctx->shaping != NULL && fons__getState(ctx)->useShaping) {
+    if(ctx->shaping != NULL && ctx->shaping->result != NULL && fons__getState(ctx)->useShaping) {
         FONSshapingRes* res = ctx->shaping->result;
         stash->nbGlyph = res->glyphCount;
         fons__clearShaping(ctx);
     } else {
-        const char* str = s;
-        const char* end = s + strlen(s);
-        int i = 0;
-        unsigned int utf8state = 0;
-        unsigned int codepoint = 0;
-
         // count glyphs
-        for (; str != end; ++str) {
-            if (fons__decutf8(&utf8state, &codepoint, *(const unsigned char*)str))
-                continue;
-            i++;
-        }
-        stash->nbGlyph = i;
+        stash->nbGlyph = fons__maxi(fons__decodeText(ctx, s, s + strlen(s)), 0);
     }
 
     stash->padding = stash->nbGlyph * GLYPH_VERTS * gl->layout.nbComponents;
@@ -522,6 +644,7 @@ void glfonsBufferDelete(GLFONScontext* gl, fsuint id) {
     }
 
     buffer->interleavedArray.clear();
+    buffer->ranges.clear();
     buffer->stashes.clear();
     delete buffer;
     gl->buffers.erase(id);
@@ -633,9 +756,15 @@ static void glfons__renderDelete(void* userPtr) {
         if(gl->atlas != 0) {
             glDeleteTextures(1, &gl->atlas);
         }
+        if(gl->atlasRGB != 0) {
+            glDeleteTextures(1, &gl->atlasRGB);
+        }
         if (gl->program) {
             glDeleteProgram(gl->program);
         }
+        if (gl->programMSDF) {
+            glDeleteProgram(gl->programMSDF);
+        }
     }
     delete gl;
 }
@@ -662,8 +791,11 @@ FONScontext* glfonsCreate(int width, int height, int flags, GLFONSparams glParam
     FONSparams params;
     GLFONScontext* gl = new GLFONScontext;
 
+    gl->atlasRGB = 0;
+
     if(glParams.useGLBackend) {
         glParams.updateAtlas = glfons__udpateAtas;
+        glParams.updateAtlasRGB = glfons__updateAtlasRGB;
         glParams.updateBuffer = glfons__updateBuffer;
         gl->userPtr = gl;
         glfons__initShaders(gl);
@@ -685,6 +817,7 @@ FONScontext* glfonsCreate(int width, int height, int flags, GLFONSparams glParam
     params.renderDraw = glfons__renderDraw;
     params.renderDelete = glfons__renderDelete;
     params.pushQuad = NULL;
+    params.renderUpdateRGB = glfons__renderUpdateRGB;
 
     params.userPtr = gl;
 
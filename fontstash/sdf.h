@@ -52,11 +52,52 @@ void sdfBuildDistanceFieldNoAlloc(unsigned char* out, int outstride, float radiu
                                   const unsigned char* img, int width, int height, int stride,
                                   unsigned char* temp);
 
+// Same as sdfBuildDistanceField, but uses a linear time separable Euclidean distance transform
+// (Felzenszwalb & Huttenlocher, Distance Transforms of Sampled Functions) seeded with the same
+// sub-pixel edge distances. It always runs in two passes, which is faster for large images and radii.
+int sdfBuildDistanceFieldEDT(unsigned char* out, int outstride, float radius,
+                             const unsigned char* img, int width, int height, int stride);
+
+// Same as sdfBuildDistanceFieldEDT, but does not allocate any memory.
+// The 'temp' array should be enough to fit sdfEDTTempSize(width, height) bytes, about 8 bytes per pixel.
+void sdfBuildDistanceFieldEDTNoAlloc(unsigned char* out, int outstride, float radius,
+                                     const unsigned char* img, int width, int height, int stride,
+                                     unsigned char* temp);
+int sdfEDTTempSize(int width, int height);
+
+// Runs job(arg, i) for each i in [0,n) and returns when all of them are done. The jobs of one call
+// are independent and can be run on several threads at the same time.
+typedef void (*SDFparallelFor)(void* uptr, void (*job)(void* arg, int i), void* arg, int n);
+
+// Same as sdfBuildDistanceFieldEDTNoAlloc, but each pass is split into jobs run through 'pfor'.
+// The rows and columns are split into 'njobs' ranges, and the refinement sweeps are done in blocks
+// along diagonal wavefronts, so the output is identical to sdfBuildDistanceFieldEDTNoAlloc.
+// The 'temp' array should be enough to fit sdfEDTParallelTempSize(width, height, njobs) bytes.
+void sdfBuildDistanceFieldEDTParallel(unsigned char* out, int outstride, float radius,
+                                      const unsigned char* img, int width, int height, int stride,
+                                      unsigned char* temp, int njobs, SDFparallelFor pfor, void* uptr);
+int sdfEDTParallelTempSize(int width, int height, int njobs);
+
+// Same as sdfBuildDistanceField, but the nearest edge points are only propagated from the edge
+// pixels to pixels within the radius of the narrow band. The rest of the pixels are set to
+// 0 (outside) or 255 (inside) from the input coverage, so the time spent follows the length
+// of the outline rather than the area of the image.
+int sdfBuildDistanceFieldNarrowBand(unsigned char* out, int outstride, float radius,
+                                    const unsigned char* img, int width, int height, int stride);
+
+// Same as sdfBuildDistanceFieldNarrowBand, but does not allocate any memory.
+// The 'temp' array should be enough to fit sdfNarrowBandTempSize(width, height) bytes, 13 bytes per pixel.
+void sdfBuildDistanceFieldNarrowBandNoAlloc(unsigned char* out, int outstride, float radius,
+                                            const unsigned char* img, int width, int height, int stride,
+                                            unsigned char* temp);
+int sdfNarrowBandTempSize(int width, int height);
+
 // This function converts the antialiased image where each pixel represents coverage (box-filter
 // sampling of the ideal, crisp edge) to a distance field with narrow band radius of sqrt(2).
 // This is the fastest way to turn antialised image to contour texture. This function is good
 // if you don't need the distance field for effects (i.e. fat outline or dropshadow).
-// Input and output buffers must be different.
+// Input and output buffers must be different. Uses SSE2/NEON when available, and AVX2 when built for it,
+// define SDF_NO_SIMD to disable. See sdfCoverageToDistanceFieldISA to pick the instruction set at runtime.
 //   out - Output of the distance transform, one byte per pixel.
 //   outstride - Bytes per row on output image.
 //   img - Input image, one byte per pixel.
@@ -66,6 +107,63 @@ void sdfBuildDistanceFieldNoAlloc(unsigned char* out, int outstride, float radiu
 void sdfCoverageToDistanceField(unsigned char* out, int outstride,
                                 const unsigned char* img, int width, int height, int stride);
 
+// Instruction sets of the vectorized kernels.
+enum SDFisa {
+    SDF_ISA_SCALAR = 0,
+    SDF_ISA_SSE2 = 1,
+    SDF_ISA_AVX2 = 2,
+    SDF_ISA_NEON = 3,
+};
+
+// Returns 1 if the kernels of the instruction set were compiled in, see SDF_NO_SIMD.
+int sdfHasISA(int isa);
+
+// Same as sdfCoverageToDistanceField, but uses the kernels of the given instruction set, which the
+// running CPU must support. The output is the same for all of them. Returns 0 if they were not compiled in.
+int sdfCoverageToDistanceFieldISA(unsigned char* out, int outstride,
+                                  const unsigned char* img, int width, int height, int stride, int isa);
+
+// Fixed point versions of sdfCoverageToDistanceField and sdfBuildDistanceFieldEDT for targets with
+// slow or no floating point, the per pixel work is done with 32-bit integers and small tables.
+// The output is within a few values of the float versions. The 'temp' array of the NoAlloc
+// version should be enough to fit sdfEDTTempSize(width, height) bytes.
+void sdfCoverageToDistanceFieldFixed(unsigned char* out, int outstride,
+                                     const unsigned char* img, int width, int height, int stride);
+int sdfBuildDistanceFieldEDTFixed(unsigned char* out, int outstride, float radius,
+                                  const unsigned char* img, int width, int height, int stride);
+void sdfBuildDistanceFieldEDTFixedNoAlloc(unsigned char* out, int outstride, float radius,
+                                          const unsigned char* img, int width, int height, int stride,
+                                          unsigned char* temp);
+
+// Multi-channel distance field (MSDF) from polygonal contours, based on msdfgen by Viktor Chlumsky.
+//
+// The contours are split at corners and the edges between corners are colored so that each corner
+// is formed by two edge groups that share only one channel. The median of the three channels then
+// reconstructs sharp corners at any magnification, where a single channel field rounds them.
+// Points flagged as smooth (the inner points of flattened curves) are never treated as corners.
+// The winding of the contours does not matter, non-zero fill rule is used to resolve the sign.
+//
+// Each channel is encoded like in sdfBuildDistanceField, 0 = radius (outside) and 255 = -radius (inside).
+//   out - Output of the distance transform, three bytes (RGB) per pixel.
+//   outstride - Bytes per row on output image.
+//   radius - The radius of the distance field narrow band in pixels.
+//   pts - Contour points as x,y pairs, in output pixel units.
+//   smooth - Optional, one flag per point, non-zero if the point is not a corner candidate.
+//   contours - Number of points in each closed contour.
+//   ncontours - Number of contours.
+//   width - Width if the image.
+//   height - Height if the image.
+int sdfBuildMultiChannelDistanceField(unsigned char* out, int outstride, float radius,
+                                      const float* pts, const unsigned char* smooth,
+                                      const int* contours, int ncontours, int width, int height);
+
+// Same as sdfBuildMultiChannelDistanceField, but does not allocate any memory.
+// The 'temp' array should be enough to fit one byte per contour point.
+void sdfBuildMultiChannelDistanceFieldNoAlloc(unsigned char* out, int outstride, float radius,
+                                              const float* pts, const unsigned char* smooth,
+                                              const int* contours, int ncontours, int width, int height,
+                                              unsigned char* temp);
+
 #endif //SDF_H
 
 
@@ -73,6 +171,39 @@ void sdfCoverageToDistanceField(unsigned char* out, int outstride,
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifndef SDF_NO_SIMD
+#	if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#		define SDF_SSE2
+#		include <emmintrin.h>
+		// The AVX2 kernels are built for the target when the compiler allows it and picked at runtime.
+#		if defined(__AVX2__) || defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+#			define SDF_AVX2
+#			include <immintrin.h>
+#		endif
+#	elif defined(__aarch64__) && defined(__ARM_NEON)
+#		define SDF_NEON
+#		include <arm_neon.h>
+#	endif
+#endif
+
+#if defined(SDF_AVX2) && !defined(__AVX2__) && (defined(__GNUC__) || defined(__clang__))
+#	define SDF_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#	define SDF_TARGET_AVX2
+#endif
+
+// Best instruction set enabled at compile time, used by sdfCoverageToDistanceField.
+#if defined(SDF_AVX2) && defined(__AVX2__)
+#	define SDF_ISA_DEFAULT SDF_ISA_AVX2
+#elif defined(SDF_SSE2)
+#	define SDF_ISA_DEFAULT SDF_ISA_SSE2
+#elif defined(SDF_NEON)
+#	define SDF_ISA_DEFAULT SDF_ISA_NEON
+#else
+#	define SDF_ISA_DEFAULT SDF_ISA_SCALAR
+#endif
 
 #define SDF_MAX_PASSES 10		// Maximum number of distance transform passes
 #define SDF_SLACK 0.001f		// Controls how much smaller the neighbour value must be to cosnider, too small slack increse iteration count.
@@ -84,11 +215,262 @@ static float sdf__clamp01(float x)
     return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
 }
 
-void sdfCoverageToDistanceField(unsigned char* out, int outstride,
-                                const unsigned char* img, int width, int height, int stride)
+static unsigned char sdf__coverageToDistance(const unsigned char* img, int stride)
+{
+    float d, gx, gy, hi, lo, glen, a, a1;
+
+    // Skip flat areas.
+    if (img[0] == 255)
+        return 255;
+    if (img[0] == 0) {
+        // Special handling for cases where full opaque pixels are next to full transparent pixels.
+        // See: https://github.com/memononen/SDF/issues/2
+        int he = img[-1] == 255 || img[1] == 255;
+        int ve = img[-stride] == 255 || img[stride] == 255;
+        if (!he && !ve)
+            return 0;
+    }
+
+    // The terms are added in the same order as in the vector versions below, so that all of them round the same way.
+    gx = ((float)img[-stride+1] + (float)img[stride+1]) - ((float)img[-stride-1] + (float)img[stride-1]) + SDF_SQRT2*((float)img[1] - (float)img[-1]);
+    gy = ((float)img[stride-1] + (float)img[stride+1]) - ((float)img[-stride-1] + (float)img[-stride+1]) + SDF_SQRT2*((float)img[stride] - (float)img[-stride]);
+    a = (float)img[0]/255.0f;
+    gx = fabsf(gx);
+    gy = fabsf(gy);
+    if (gx < 0.0001f) {
+        d = (0.5f - a) * SDF_SQRT2;
+    } else {
+        glen = 1.0f / sqrtf(gx*gx + gy*gy);
+        hi = (gx > gy ? gx : gy) * glen;
+        lo = (gx < gy ? gx : gy) * glen;
+        a1 = 0.5f*lo/hi;
+        if (a < a1) { // 0 <= a < a1
+            d = 0.5f*(hi + lo) - sqrtf(2.0f*(hi*lo)*a);
+        } else if (a < 1.0f-a1) { // a1 <= a <= 1-a1
+            d = (0.5f-a)*hi;
+        } else { // 1-a1 < a <= 1
+            d = sqrtf(2.0f*(hi*lo)*(1.0f-a)) - 0.5f*(hi + lo);
+        }
+    }
+    return (unsigned char)(sdf__clamp01(0.5f - d*(1.0f / SDF_SQRT2)) * 255.0f);
+}
+
+// The vector versions below evaluate all the cases of sdf__coverageToDistance and select
+// the result per lane. They convert a span of a row and return where the span ended.
+#ifdef SDF_AVX2
+static SDF_TARGET_AVX2 __m256 sdf__load8AVX2(const unsigned char* p)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+static SDF_TARGET_AVX2 int sdf__coverageSpanAVX2(unsigned char* out, const unsigned char* img, int x, int x1, int stride)
+{
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), half = _mm256_set1_ps(0.5f);
+    const __m256 two = _mm256_set1_ps(2.0f), c255 = _mm256_set1_ps(255.0f), sqrt2 = _mm256_set1_ps(SDF_SQRT2);
+    const __m256 sign = _mm256_set1_ps(-0.0f), eps = _mm256_set1_ps(0.0001f), isqrt2 = _mm256_set1_ps(1.0f / SDF_SQRT2);
+    for (; x + 8 <= x1; x += 8) {
+        const unsigned char* p = img + x;
+        __m256 tl = sdf__load8AVX2(p-stride-1), t = sdf__load8AVX2(p-stride), tr = sdf__load8AVX2(p-stride+1);
+        __m256 l = sdf__load8AVX2(p-1), c = sdf__load8AVX2(p), r = sdf__load8AVX2(p+1);
+        __m256 bl = sdf__load8AVX2(p+stride-1), b = sdf__load8AVX2(p+stride), br = sdf__load8AVX2(p+stride+1);
+        __m256 gx, gy, a, glen, hi, lo, a1, d, edge, full, empty;
+        __m128i lo4, hi4;
+
+        // Flat areas, blocks without edge pixels are written without evaluating the edge cases.
+        edge = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(l, c255, _CMP_EQ_OQ), _mm256_cmp_ps(r, c255, _CMP_EQ_OQ)),
+                            _mm256_or_ps(_mm256_cmp_ps(t, c255, _CMP_EQ_OQ), _mm256_cmp_ps(b, c255, _CMP_EQ_OQ)));
+        full = _mm256_cmp_ps(c, c255, _CMP_EQ_OQ);
+        empty = _mm256_andnot_ps(edge, _mm256_cmp_ps(c, zero, _CMP_EQ_OQ));
+        if (_mm256_movemask_ps(_mm256_or_ps(full, empty)) == 0xff) {
+            lo4 = _mm_packs_epi32(_mm256_castsi256_si128(_mm256_castps_si256(full)), _mm256_extracti128_si256(_mm256_castps_si256(full), 1));
+            _mm_storel_epi64((__m128i*)&out[x], _mm_packs_epi16(lo4, lo4));
+            continue;
+        }
+
+        gx = _mm256_add_ps(_mm256_sub_ps(_mm256_add_ps(tr, br), _mm256_add_ps(tl, bl)), _mm256_mul_ps(sqrt2, _mm256_sub_ps(r, l)));
+        gy = _mm256_add_ps(_mm256_sub_ps(_mm256_add_ps(bl, br), _mm256_add_ps(tl, tr)), _mm256_mul_ps(sqrt2, _mm256_sub_ps(b, t)));
+        gx = _mm256_andnot_ps(sign, gx);
+        gy = _mm256_andnot_ps(sign, gy);
+        a = _mm256_div_ps(c, c255);
+        glen = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gy, gy))));
+        hi = _mm256_mul_ps(_mm256_max_ps(gx, gy), glen);
+        lo = _mm256_mul_ps(_mm256_min_ps(gx, gy), glen);
+        a1 = _mm256_div_ps(_mm256_mul_ps(half, lo), hi);
+
+        d = _mm256_sub_ps(_mm256_sqrt_ps(_mm256_mul_ps(_mm256_mul_ps(two, _mm256_mul_ps(hi, lo)), _mm256_sub_ps(one, a))),
+                          _mm256_mul_ps(half, _mm256_add_ps(hi, lo)));
+        d = _mm256_blendv_ps(d, _mm256_mul_ps(_mm256_sub_ps(half, a), hi), _mm256_cmp_ps(a, _mm256_sub_ps(one, a1), _CMP_LT_OQ));
+        d = _mm256_blendv_ps(d, _mm256_sub_ps(_mm256_mul_ps(half, _mm256_add_ps(hi, lo)), _mm256_sqrt_ps(_mm256_mul_ps(_mm256_mul_ps(two, _mm256_mul_ps(hi, lo)), a))),
+                             _mm256_cmp_ps(a, a1, _CMP_LT_OQ));
+        d = _mm256_blendv_ps(d, _mm256_mul_ps(_mm256_sub_ps(half, a), sqrt2), _mm256_cmp_ps(gx, eps, _CMP_LT_OQ));
+        d = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(half, _mm256_mul_ps(d, isqrt2)), zero), one), c255);
+
+        d = _mm256_andnot_ps(empty, d);
+        d = _mm256_blendv_ps(d, c255, full);
+
+        lo4 = _mm256_castsi256_si128(_mm256_cvttps_epi32(d));
+        hi4 = _mm256_extracti128_si256(_mm256_cvttps_epi32(d), 1);
+        lo4 = _mm_packs_epi32(lo4, hi4);
+        _mm_storel_epi64((__m128i*)&out[x], _mm_packus_epi16(lo4, lo4));
+    }
+    return x;
+}
+#endif
+
+#if defined(SDF_SSE2)
+static __m128 sdf__load4SSE2(const unsigned char* p)
+{
+    int v;
+    __m128i i;
+    memcpy(&v, p, 4);
+    i = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), _mm_setzero_si128());
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(i, _mm_setzero_si128()));
+}
+
+static __m128 sdf__selectSSE2(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static int sdf__coverageSpanSSE2(unsigned char* out, const unsigned char* img, int x, int x1, int stride)
+{
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+    const __m128 two = _mm_set1_ps(2.0f), c255 = _mm_set1_ps(255.0f), sqrt2 = _mm_set1_ps(SDF_SQRT2);
+    const __m128 sign = _mm_set1_ps(-0.0f), eps = _mm_set1_ps(0.0001f), isqrt2 = _mm_set1_ps(1.0f / SDF_SQRT2);
+    for (; x + 4 <= x1; x += 4) {
+        const unsigned char* p = img + x;
+        __m128 tl = sdf__load4SSE2(p-stride-1), t = sdf__load4SSE2(p-stride), tr = sdf__load4SSE2(p-stride+1);
+        __m128 l = sdf__load4SSE2(p-1), c = sdf__load4SSE2(p), r = sdf__load4SSE2(p+1);
+        __m128 bl = sdf__load4SSE2(p+stride-1), b = sdf__load4SSE2(p+stride), br = sdf__load4SSE2(p+stride+1);
+        __m128 gx, gy, a, glen, hi, lo, a1, d, edge, full, empty;
+        __m128i v;
+
+        // Flat areas, blocks without edge pixels are written without evaluating the edge cases.
+        edge = _mm_or_ps(_mm_or_ps(_mm_cmpeq_ps(l, c255), _mm_cmpeq_ps(r, c255)),
+                         _mm_or_ps(_mm_cmpeq_ps(t, c255), _mm_cmpeq_ps(b, c255)));
+        full = _mm_cmpeq_ps(c, c255);
+        empty = _mm_andnot_ps(edge, _mm_cmpeq_ps(c, zero));
+        if (_mm_movemask_ps(_mm_or_ps(full, empty)) == 0xf) {
+            v = _mm_packs_epi32(_mm_castps_si128(full), _mm_castps_si128(full));
+            v = _mm_cvtsi32_si128(_mm_cvtsi128_si32(_mm_packs_epi16(v, v)));
+            memcpy(&out[x], &v, 4);
+            continue;
+        }
+
+        gx = _mm_add_ps(_mm_sub_ps(_mm_add_ps(tr, br), _mm_add_ps(tl, bl)), _mm_mul_ps(sqrt2, _mm_sub_ps(r, l)));
+        gy = _mm_add_ps(_mm_sub_ps(_mm_add_ps(bl, br), _mm_add_ps(tl, tr)), _mm_mul_ps(sqrt2, _mm_sub_ps(b, t)));
+        gx = _mm_andnot_ps(sign, gx);
+        gy = _mm_andnot_ps(sign, gy);
+        a = _mm_div_ps(c, c255);
+        glen = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy))));
+        hi = _mm_mul_ps(_mm_max_ps(gx, gy), glen);
+        lo = _mm_mul_ps(_mm_min_ps(gx, gy), glen);
+        a1 = _mm_div_ps(_mm_mul_ps(half, lo), hi);
+
+        d = _mm_sub_ps(_mm_sqrt_ps(_mm_mul_ps(_mm_mul_ps(two, _mm_mul_ps(hi, lo)), _mm_sub_ps(one, a))),
+                       _mm_mul_ps(half, _mm_add_ps(hi, lo)));
+        d = sdf__selectSSE2(_mm_cmplt_ps(a, _mm_sub_ps(one, a1)), _mm_mul_ps(_mm_sub_ps(half, a), hi), d);
+        d = sdf__selectSSE2(_mm_cmplt_ps(a, a1), _mm_sub_ps(_mm_mul_ps(half, _mm_add_ps(hi, lo)),
+                            _mm_sqrt_ps(_mm_mul_ps(_mm_mul_ps(two, _mm_mul_ps(hi, lo)), a))), d);
+        d = sdf__selectSSE2(_mm_cmplt_ps(gx, eps), _mm_mul_ps(_mm_sub_ps(half, a), sqrt2), d);
+        d = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_sub_ps(half, _mm_mul_ps(d, isqrt2)), zero), one), c255);
+
+        d = _mm_andnot_ps(empty, d);
+        d = sdf__selectSSE2(full, c255, d);
+
+        v = _mm_cvttps_epi32(d);
+        v = _mm_packs_epi32(v, v);
+        v = _mm_cvtsi32_si128(_mm_cvtsi128_si32(_mm_packus_epi16(v, v)));
+        memcpy(&out[x], &v, 4);
+    }
+    return x;
+}
+#elif defined(SDF_NEON)
+static float32x4_t sdf__load4NEON(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(v))))));
+}
+
+static int sdf__coverageSpanNEON(unsigned char* out, const unsigned char* img, int x, int x1, int stride)
+{
+    const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f), half = vdupq_n_f32(0.5f);
+    const float32x4_t c255 = vdupq_n_f32(255.0f), eps = vdupq_n_f32(0.0001f);
+    for (; x + 4 <= x1; x += 4) {
+        const unsigned char* p = img + x;
+        float32x4_t tl = sdf__load4NEON(p-stride-1), t = sdf__load4NEON(p-stride), tr = sdf__load4NEON(p-stride+1);
+        float32x4_t l = sdf__load4NEON(p-1), c = sdf__load4NEON(p), r = sdf__load4NEON(p+1);
+        float32x4_t bl = sdf__load4NEON(p+stride-1), b = sdf__load4NEON(p+stride), br = sdf__load4NEON(p+stride+1);
+        float32x4_t gx, gy, a, glen, hi, lo, a1, d, hl;
+        uint32x4_t edge, flat, full;
+        uint16x4_t v16;
+        uint32_t v;
+
+        // Flat areas, blocks without edge pixels are written without evaluating the edge cases.
+        edge = vorrq_u32(vorrq_u32(vceqq_f32(l, c255), vceqq_f32(r, c255)),
+                         vorrq_u32(vceqq_f32(t, c255), vceqq_f32(b, c255)));
+        full = vceqq_f32(c, c255);
+        flat = vbicq_u32(vceqq_f32(c, zero), edge);
+        if (vminvq_u32(vorrq_u32(full, flat)) != 0) {
+            v16 = vmovn_u32(full);
+            v = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(v16, v16))), 0);
+            memcpy(&out[x], &v, 4);
+            continue;
+        }
+
+        gx = vaddq_f32(vsubq_f32(vaddq_f32(tr, br), vaddq_f32(tl, bl)), vmulq_n_f32(vsubq_f32(r, l), SDF_SQRT2));
+        gy = vaddq_f32(vsubq_f32(vaddq_f32(bl, br), vaddq_f32(tl, tr)), vmulq_n_f32(vsubq_f32(b, t), SDF_SQRT2));
+        gx = vabsq_f32(gx);
+        gy = vabsq_f32(gy);
+        a = vdivq_f32(c, c255);
+        glen = vdivq_f32(one, vsqrtq_f32(vaddq_f32(vmulq_f32(gx, gx), vmulq_f32(gy, gy))));
+        hi = vmulq_f32(vmaxq_f32(gx, gy), glen);
+        lo = vmulq_f32(vminq_f32(gx, gy), glen);
+        a1 = vdivq_f32(vmulq_f32(half, lo), hi);
+        hl = vmulq_n_f32(vmulq_f32(hi, lo), 2.0f);
+
+        d = vsubq_f32(vsqrtq_f32(vmulq_f32(hl, vsubq_f32(one, a))), vmulq_f32(half, vaddq_f32(hi, lo)));
+        d = vbslq_f32(vcltq_f32(a, vsubq_f32(one, a1)), vmulq_f32(vsubq_f32(half, a), hi), d);
+        d = vbslq_f32(vcltq_f32(a, a1), vsubq_f32(vmulq_f32(half, vaddq_f32(hi, lo)), vsqrtq_f32(vmulq_f32(hl, a))), d);
+        d = vbslq_f32(vcltq_f32(gx, eps), vmulq_n_f32(vsubq_f32(half, a), SDF_SQRT2), d);
+        d = vmulq_f32(vminq_f32(vmaxq_f32(vsubq_f32(half, vmulq_n_f32(d, 1.0f / SDF_SQRT2)), zero), one), c255);
+
+        d = vbslq_f32(flat, zero, d);
+        d = vbslq_f32(full, c255, d);
+
+        v16 = vmovn_u32(vcvtq_u32_f32(d));
+        v = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(v16, v16))), 0);
+        memcpy(&out[x], &v, 4);
+    }
+    return x;
+}
+#endif
+
+int sdfHasISA(int isa)
+{
+    switch (isa) {
+    case SDF_ISA_SCALAR: return 1;
+#ifdef SDF_SSE2
+    case SDF_ISA_SSE2: return 1;
+#endif
+#ifdef SDF_AVX2
+    case SDF_ISA_AVX2: return 1;
+#endif
+#ifdef SDF_NEON
+    case SDF_ISA_NEON: return 1;
+#endif
+    }
+    return 0;
+}
+
+int sdfCoverageToDistanceFieldISA(unsigned char* out, int outstride,
+                                  const unsigned char* img, int width, int height, int stride, int isa)
 {
     int x, y;
-    
+
+    if (!sdfHasISA(isa)) return 0;
+
     // Zero out borders
     for (x = 0; x < width; x++)
         out[x] = 0;
@@ -100,56 +482,30 @@ void sdfCoverageToDistanceField(unsigned char* out, int outstride,
         out[x+(height-1)*outstride] = 0;
     
     for (y = 1; y < height-1; y++) {
-        for (x = 1; x < width-1; x++) {
-            int k = x + y * stride;
-            float d, gx, gy, glen, a, a1;
-            
-            // Skip flat areas.
-            if (img[k] == 255) {
-                out[x+y*outstride] = 255;
-                continue;
-            }
-            if (img[k] == 0) {
-                // Special handling for cases where full opaque pixels are next to full transparent pixels.
-                // See: https://github.com/memononen/SDF/issues/2
-                int he = img[k-1] == 255 || img[k+1] == 255;
-                int ve = img[k-stride] == 255 || img[k+stride] == 255;
-                if (!he && !ve) {
-                    out[x+y*outstride] = 0;
-                    continue;
-                }
-            }
-            
-            gx = -(float)img[k-stride-1] - SDF_SQRT2*(float)img[k-1] - (float)img[k+stride-1] + (float)img[k-stride+1] + SDF_SQRT2*(float)img[k+1] + (float)img[k+stride+1];
-            gy = -(float)img[k-stride-1] - SDF_SQRT2*(float)img[k-stride] - (float)img[k-stride+1] + (float)img[k+stride-1] + SDF_SQRT2*(float)img[k+stride] + (float)img[k+stride+1];
-            a = (float)img[k]/255.0f;
-            gx = fabsf(gx);
-            gy = fabsf(gy);
-            if (gx < 0.0001f || gy < 0.000f) {
-                d = (0.5f - a) * SDF_SQRT2;
-            } else {
-                glen = gx*gx + gy*gy;
-                glen = 1.0f / sqrtf(glen);
-                gx *= glen;
-                gy *= glen;
-                if (gx < gy) {
-                    float temp = gx;
-                    gx = gy;
-                    gy = temp;
-                }
-                a1 = 0.5f*gy/gx;
-                if (a < a1) { // 0 <= a < a1
-                    d = 0.5f*(gx + gy) - sqrtf(2.0f*gx*gy*a);
-                } else if (a < (1.0-a1)) { // a1 <= a <= 1-a1
-                    d = (0.5f-a)*gx;
-                } else { // 1-a1 < a <= 1
-                    d = -0.5f*(gx + gy) + sqrt(2.0f*gx*gy*(1.0f-a));
-                }
-            }
-            d *= 1.0f / SDF_SQRT2;
-            out[x+y*outstride] = (unsigned char)(sdf__clamp01(0.5f - d) * 255.0f);
-        }
+        const unsigned char* row = &img[y*stride];
+        unsigned char* dst = &out[y*outstride];
+        x = 1;
+#ifdef SDF_AVX2
+        if (isa == SDF_ISA_AVX2)
+            x = sdf__coverageSpanAVX2(dst, row, x, width-1, stride);
+#endif
+#if defined(SDF_SSE2)
+        if (isa != SDF_ISA_SCALAR)
+            x = sdf__coverageSpanSSE2(dst, row, x, width-1, stride);
+#elif defined(SDF_NEON)
+        if (isa == SDF_ISA_NEON)
+            x = sdf__coverageSpanNEON(dst, row, x, width-1, stride);
+#endif
+        for (; x < width-1; x++)
+            dst[x] = sdf__coverageToDistance(&row[x], stride);
     }
+    return 1;
+}
+
+void sdfCoverageToDistanceField(unsigned char* out, int outstride,
+                                const unsigned char* img, int width, int height, int stride)
+{
+    sdfCoverageToDistanceFieldISA(out, outstride, img, width, height, stride, SDF_ISA_DEFAULT);
 }
 
 static float sdf__edgedf(float gx, float gy, float a)
@@ -186,6 +542,38 @@ struct SDFpoint {
     float x,y;
 };
 
+// Returns 1 if the pixel is on the antialiased edge, and the edge normal and distance to it.
+static int sdf__edgePixel(const unsigned char* img, int stride, float* ngx, float* ngy, float* nd)
+{
+    float gx, gy, glen;
+
+    // Skip flat areas.
+    if (img[0] == 255) return 0;
+    if (img[0] == 0) {
+        // Special handling for cases where full opaque pixels are next to full transparent pixels.
+        // See: https://github.com/memononen/SDF/issues/2
+        int he = img[-1] == 255 || img[1] == 255;
+        int ve = img[-stride] == 255 || img[stride] == 255;
+        if (!he && !ve) return 0;
+    }
+
+    // Calculate gradient direction
+    gx = -(float)img[-stride-1] - SDF_SQRT2*(float)img[-1] - (float)img[stride-1] + (float)img[-stride+1] + SDF_SQRT2*(float)img[1] + (float)img[stride+1];
+    gy = -(float)img[-stride-1] - SDF_SQRT2*(float)img[-stride] - (float)img[-stride+1] + (float)img[stride-1] + SDF_SQRT2*(float)img[stride] + (float)img[stride+1];
+    if (fabsf(gx) < 0.001f && fabsf(gy) < 0.001f) return 0;
+    glen = gx*gx + gy*gy;
+    if (glen > 0.0001f) {
+        glen = 1.0f / sqrtf(glen);
+        gx *= glen;
+        gy *= glen;
+    }
+
+    *ngx = gx;
+    *ngy = gy;
+    *nd = sdf__edgedf(gx, gy, (float)img[0]/255.0f);
+    return 1;
+}
+
 static float sdf__distsqr(struct SDFpoint* a, struct SDFpoint* b)
 {
     float dx = b->x - a->x, dy = b->y - a->y;
@@ -213,32 +601,12 @@ void sdfBuildDistanceFieldNoAlloc(unsigned char* out, int outstride, float radiu
         for (x = 1; x < width-1; x++) {
             int tk, k = x + y * stride;
             struct SDFpoint c = { (float)x, (float)y };
-            float d, gx, gy, glen;
+            float d, gx, gy;
             
-            // Skip flat areas.
-            if (img[k] == 255) continue;
-            if (img[k] == 0) {
-                // Special handling for cases where full opaque pixels are next to full transparent pixels.
-                // See: https://github.com/memononen/SDF/issues/2
-                int he = img[k-1] == 255 || img[k+1] == 255;
-                int ve = img[k-stride] == 255 || img[k+stride] == 255;
-                if (!he && !ve) continue;
-            }
-            
-            // Calculate gradient direction
-            gx = -(float)img[k-stride-1] - SDF_SQRT2*(float)img[k-1] - (float)img[k+stride-1] + (float)img[k-stride+1] + SDF_SQRT2*(float)img[k+1] + (float)img[k+stride+1];
-            gy = -(float)img[k-stride-1] - SDF_SQRT2*(float)img[k-stride] - (float)img[k-stride+1] + (float)img[k+stride-1] + SDF_SQRT2*(float)img[k+stride] + (float)img[k+stride+1];
-            if (fabsf(gx) < 0.001f && fabsf(gy) < 0.001f) continue;
-            glen = gx*gx + gy*gy;
-            if (glen > 0.0001f) {
-                glen = 1.0f / sqrtf(glen);
-                gx *= glen;
-                gy *= glen;
-            }
+            if (!sdf__edgePixel(&img[k], stride, &gx, &gy, &d)) continue;
             
             // Find nearest point on contour.
             tk = x + y * width;
-            d = sdf__edgedf(gx, gy, (float)img[k]/255.0f);
             tpt[tk].x = x + gx*d;
             tpt[tk].y = y + gy*d;
             tdist[tk] = sdf__distsqr(&c, &tpt[tk]);
@@ -382,4 +750,1021 @@ int sdfBuildDistanceField(unsigned char* out, int outstride, float radius,
     return 1;
 }
 
+#define SDF_EDT_INF 1e20f			// Squared distance of the pixels which are not seeded, small enough to not overflow the parabola intersections.
+#define SDF_EDT_SEED 0x80000000u	// Tags the packed edge points of the seeds, the distances are positive floats.
+#define SDF_EDT_PT_SCALE 4096.0f	// Fixed point scale of the packed edge point offsets.
+
+#define SDF_EDT_BLOCK 32			// Size of the blocks refined in parallel.
+
+int sdfEDTParallelTempSize(int width, int height, int njobs)
+{
+    int n = width > height ? width : height;
+    return (width * height * 2 + (n * 4 + 1) * njobs) * (int)sizeof(float);
+}
+
+int sdfEDTTempSize(int width, int height)
+{
+    return sdfEDTParallelTempSize(width, height, 1);
+}
+
+// 1D squared distance transform of f (n samples, 'step' apart), the lower envelope of the
+// parabolas rooted at each sample is built first and then sampled. The sample each output
+// value came from is stored in 'src'.
+static void sdf__edt1d(float* f, int n, int step, float* g, int* src, int* v, float* z)
+{
+    int q, k = 0;
+    float s;
+
+    for (q = 0; q < n; q++)
+        g[q] = f[q*step];
+
+    v[0] = 0;
+    z[0] = -SDF_EDT_INF;
+    z[1] = SDF_EDT_INF;
+    for (q = 1; q < n; q++) {
+        float fq = g[q] + (float)(q*q);
+        s = (fq - (g[v[k]] + (float)(v[k]*v[k]))) / (float)(2*q - 2*v[k]);
+        while (s <= z[k]) {
+            k--;
+            s = (fq - (g[v[k]] + (float)(v[k]*v[k]))) / (float)(2*q - 2*v[k]);
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = SDF_EDT_INF;
+    }
+
+    k = 0;
+    for (q = 0; q < n; q++) {
+        float dq;
+        while (z[k+1] < (float)q) k++;
+        dq = (float)(q - v[k]);
+        f[q*step] = dq*dq + g[v[k]];
+        src[q] = v[k];
+    }
+}
+
+static unsigned int sdf__edtPackPoint(float x, float y)
+{
+    unsigned int px = (unsigned int)(int)(x * SDF_EDT_PT_SCALE) & 0x7fff;
+    unsigned int py = (unsigned int)(int)(y * SDF_EDT_PT_SCALE) & 0xffff;
+    return SDF_EDT_SEED | px | (py << 15);
+}
+
+// Squared distance from pixel x,y to the edge point of seed s, packed as x | y << 16.
+static float sdf__edtDistSqr(const unsigned int* tpt, int s, int width, int x, int y)
+{
+    int sx = s & 0xffff, sy = s >> 16;
+    unsigned int pt = tpt[sx + sy * width];
+    float dx, dy;
+    if (!(pt & SDF_EDT_SEED)) return SDF_EDT_INF;
+    dx = (float)(sx - x) + (float)((short)(pt << 1) >> 1) * (1.0f / SDF_EDT_PT_SCALE);
+    dy = (float)(sy - y) + (float)(short)(pt >> 15) * (1.0f / SDF_EDT_PT_SCALE);
+    return dx*dx + dy*dy;
+}
+
+static void sdf__edtRefine(const unsigned int* tpt, int* tsrc, int width, int x, int y, int k0, int k1, int k2, int k3)
+{
+    int k = x + y * width, best = tsrc[k];
+    int cand[4] = { tsrc[k0], tsrc[k1], tsrc[k2], tsrc[k3] };
+    float bd = sdf__edtDistSqr(tpt, best, width, x, y);
+    int i;
+    for (i = 0; i < 4; i++) {
+        float d;
+        if (cand[i] == best) continue;
+        d = sdf__edtDistSqr(tpt, cand[i], width, x, y);
+        if (d < bd) {
+            bd = d;
+            best = cand[i];
+        }
+    }
+    tsrc[k] = best;
+}
+
+// State shared by the passes of the separable transform, each pass works on a range of rows or columns.
+struct SDFedt {
+    unsigned char* out;
+    int outstride;
+    const unsigned char* img;
+    int width, height, stride, n;
+    float radius, band;
+    float* tdist;
+    unsigned int* tpt;		// Edge points of the seeds, stored in place of their distances.
+    int* tsrc;
+    float* lines;			// Line buffers of the 1D transforms, 4n+1 floats each.
+};
+
+static void sdf__edtInit(struct SDFedt* e, unsigned char* out, int outstride, float radius,
+                         const unsigned char* img, int width, int height, int stride,
+                         unsigned char* temp)
+{
+    e->out = out;
+    e->outstride = outstride;
+    e->img = img;
+    e->width = width;
+    e->height = height;
+    e->stride = stride;
+    e->n = width > height ? width : height;
+    e->radius = radius;
+    e->band = (radius + 2.0f) * (radius + 2.0f);
+    e->tdist = (float*)&temp[0];
+    e->tpt = (unsigned int*)e->tdist;
+    e->tsrc = (int*)(e->tdist + width * height);
+    e->lines = (float*)(e->tsrc + width * height);
+}
+
+// Seed the antialiased pixels with the squared distance to the boundary of the shape.
+static void sdf__edtSeed(struct SDFedt* e, int y0, int y1)
+{
+    int x, y, width = e->width;
+    for (y = y0; y < y1; y++) {
+        for (x = 0; x < width; x++)
+            e->tdist[x + y * width] = SDF_EDT_INF;
+        if (y == 0 || y == e->height-1) continue;
+        for (x = 1; x < width-1; x++) {
+            float gx, gy, dist;
+            if (sdf__edgePixel(&e->img[x + y * e->stride], e->stride, &gx, &gy, &dist))
+                e->tdist[x + y * width] = dist * dist;
+        }
+    }
+}
+
+// Columns, keeping track of the nearest seed row.
+static void sdf__edtColumns(struct SDFedt* e, int x0, int x1, float* line)
+{
+    int x, y, n = e->n, width = e->width;
+    float* g = line;
+    int* src = (int*)(g + n);
+    int* v = src + n;
+    float* z = (float*)(v + n);
+    for (x = x0; x < x1; x++) {
+        sdf__edt1d(&e->tdist[x], e->height, width, g, src, v, z);
+        for (y = 0; y < e->height; y++)
+            e->tsrc[x + y * width] = src[y];
+    }
+}
+
+// Rows, the nearest seed pixel is stored as x | y << 16.
+static void sdf__edtRows(struct SDFedt* e, int y0, int y1, float* line)
+{
+    int x, y, n = e->n, width = e->width;
+    float* g = line;
+    int* src = (int*)(g + n);
+    int* v = src + n;
+    float* z = (float*)(v + n);
+    for (y = y0; y < y1; y++) {
+        int* row = &e->tsrc[y * width];
+        sdf__edt1d(&e->tdist[y * width], width, 1, g, src, v, z);
+        for (x = 0; x < width; x++)
+            v[x] = src[x] | (row[src[x]] << 16);
+        for (x = 0; x < width; x++)
+            row[x] = v[x];
+    }
+}
+
+// The seed with the smallest distance to its edge point is not always the one found above.
+// Store the edge points of the seeds in place of their distances, the refinement sweeps then
+// pick the nearest seed from the neighbours within the band. The input is not read after this,
+// except for the sign of each pixel, so the input and output can be the same buffer.
+static void sdf__edtPack(struct SDFedt* e, int y0, int y1)
+{
+    int x, y;
+    if (y0 < 1) y0 = 1;
+    if (y1 > e->height-1) y1 = e->height-1;
+    for (y = y0; y < y1; y++) {
+        for (x = 1; x < e->width-1; x++) {
+            float gx, gy, dist;
+            if (sdf__edgePixel(&e->img[x + y * e->stride], e->stride, &gx, &gy, &dist))
+                e->tpt[x + y * e->width] = sdf__edtPackPoint(gx * dist, gy * dist);
+        }
+    }
+}
+
+// Refines the interior pixels with u0 <= x+y < u1 on rows y0 to y1-1. Each pixel looks at the neighbours
+// before it, which all have a smaller or equal x+y on the previous row or a smaller x on the same row, so
+// blocks of rows and x+y can be processed in wavefronts with the same result as one sweep.
+static void sdf__edtRefineForward(struct SDFedt* e, int u0, int u1, int y0, int y1)
+{
+    int x, y, width = e->width;
+    for (y = y0; y < y1; y++) {
+        int x0 = u0 - y > 1 ? u0 - y : 1, x1 = u1 - y < width-1 ? u1 - y : width-1;
+        for (x = x0; x < x1; x++) {
+            int k = x + y * width;
+            if ((e->tpt[k] & SDF_EDT_SEED) || e->tdist[k] < e->band)
+                sdf__edtRefine(e->tpt, e->tsrc, width, x, y, k-1, k-width-1, k-width, k-width+1);
+        }
+    }
+}
+
+static void sdf__edtRefineBackward(struct SDFedt* e, int u0, int u1, int y0, int y1)
+{
+    int x, y, width = e->width;
+    for (y = y1-1; y >= y0; y--) {
+        int x0 = u0 - y > 1 ? u0 - y : 1, x1 = u1 - y < width-1 ? u1 - y : width-1;
+        for (x = x1-1; x >= x0; x--) {
+            int k = x + y * width;
+            if ((e->tpt[k] & SDF_EDT_SEED) || e->tdist[k] < e->band)
+                sdf__edtRefine(e->tpt, e->tsrc, width, x, y, k+1, k+width+1, k+width, k+width-1);
+        }
+    }
+}
+
+// Map to good range, border is set to 0 like in sdfBuildDistanceField.
+static void sdf__edtOutput(struct SDFedt* e, int y0, int y1)
+{
+    int x, y, width = e->width, height = e->height;
+    float scale = 1.0f / e->radius;
+    for (y = y0; y < y1; y++) {
+        for (x = 0; x < width; x++) {
+            int k = x + y * width;
+            float dist;
+            if (x == 0 || y == 0 || x == width-1 || y == height-1) {
+                e->out[x+y*e->outstride] = 0;
+                continue;
+            }
+            if ((e->tpt[k] & SDF_EDT_SEED) || e->tdist[k] < e->band)
+                dist = sdf__edtDistSqr(e->tpt, e->tsrc[k], width, x, y);
+            else
+                dist = e->tdist[k];
+            dist = sqrtf(dist) * scale;
+            if (e->img[x+y*e->stride] > 127) dist = -dist;
+            e->out[x+y*e->outstride] = (unsigned char)(sdf__clamp01(0.5f - dist*0.5f) * 255.0f);
+        }
+    }
+}
+
+void sdfBuildDistanceFieldEDTNoAlloc(unsigned char* out, int outstride, float radius,
+                                     const unsigned char* img, int width, int height, int stride,
+                                     unsigned char* temp)
+{
+    struct SDFedt e;
+    sdf__edtInit(&e, out, outstride, radius, img, width, height, stride, temp);
+    sdf__edtSeed(&e, 0, height);
+    sdf__edtColumns(&e, 0, width, e.lines);
+    sdf__edtRows(&e, 0, height, e.lines);
+    sdf__edtPack(&e, 0, height);
+    sdf__edtRefineForward(&e, 0, width + height, 1, height-1);
+    sdf__edtRefineBackward(&e, 0, width + height, 1, height-1);
+    sdf__edtOutput(&e, 0, height);
+}
+
+enum SDFedtPass {
+    SDF_EDT_PASS_SEED,
+    SDF_EDT_PASS_COLUMNS,
+    SDF_EDT_PASS_ROWS,
+    SDF_EDT_PASS_PACK,
+    SDF_EDT_PASS_FORWARD,
+    SDF_EDT_PASS_BACKWARD,
+    SDF_EDT_PASS_OUTPUT,
+};
+
+struct SDFedtJob {
+    struct SDFedt* e;
+    int pass, njobs;
+    int wave, nbu, nby;		// Refinement wavefront and number of blocks along x+y and y.
+};
+
+// First block row of a wavefront of the refinement, the blocks of a wavefront have bu + by == wave.
+static int sdf__edtWaveStart(const struct SDFedtJob* job)
+{
+    int by = job->wave - (job->nbu-1);
+    return by > 0 ? by : 0;
+}
+
+static int sdf__edtWaveSize(const struct SDFedtJob* job)
+{
+    int by1 = job->wave < job->nby-1 ? job->wave : job->nby-1;
+    return by1 - sdf__edtWaveStart(job) + 1;
+}
+
+static void sdf__edtJob(void* arg, int i)
+{
+    struct SDFedtJob* job = (struct SDFedtJob*)arg;
+    struct SDFedt* e = job->e;
+    int n = job->pass == SDF_EDT_PASS_COLUMNS ? e->width : e->height;
+    int i0 = n * i / job->njobs, i1 = n * (i+1) / job->njobs;
+    float* line = e->lines + (e->n * 4 + 1) * i;
+
+    if (job->pass == SDF_EDT_PASS_FORWARD || job->pass == SDF_EDT_PASS_BACKWARD) {
+        int by = sdf__edtWaveStart(job) + i, bu = job->wave - by;
+        int u0 = 2 + bu * SDF_EDT_BLOCK, y0 = 1 + by * SDF_EDT_BLOCK;
+        int y1 = y0 + SDF_EDT_BLOCK < e->height-1 ? y0 + SDF_EDT_BLOCK : e->height-1;
+        if (job->pass == SDF_EDT_PASS_FORWARD)
+            sdf__edtRefineForward(e, u0, u0 + SDF_EDT_BLOCK, y0, y1);
+        else
+            sdf__edtRefineBackward(e, u0, u0 + SDF_EDT_BLOCK, y0, y1);
+        return;
+    }
+
+    switch (job->pass) {
+    case SDF_EDT_PASS_SEED: sdf__edtSeed(e, i0, i1); break;
+    case SDF_EDT_PASS_COLUMNS: sdf__edtColumns(e, i0, i1, line); break;
+    case SDF_EDT_PASS_ROWS: sdf__edtRows(e, i0, i1, line); break;
+    case SDF_EDT_PASS_PACK: sdf__edtPack(e, i0, i1); break;
+    case SDF_EDT_PASS_OUTPUT: sdf__edtOutput(e, i0, i1); break;
+    }
+}
+
+void sdfBuildDistanceFieldEDTParallel(unsigned char* out, int outstride, float radius,
+                                      const unsigned char* img, int width, int height, int stride,
+                                      unsigned char* temp, int njobs, SDFparallelFor pfor, void* uptr)
+{
+    struct SDFedt e;
+    struct SDFedtJob job;
+    int pass, nwaves;
+
+    sdf__edtInit(&e, out, outstride, radius, img, width, height, stride, temp);
+    job.e = &e;
+    job.njobs = njobs;
+    // The interior pixels have 2 <= x+y <= width+height-4.
+    job.nbu = (width + height-5 + SDF_EDT_BLOCK-1) / SDF_EDT_BLOCK;
+    job.nby = (height-2 + SDF_EDT_BLOCK-1) / SDF_EDT_BLOCK;
+    nwaves = job.nbu > 0 && job.nby > 0 ? job.nbu + job.nby-1 : 0;
+
+    for (pass = SDF_EDT_PASS_SEED; pass <= SDF_EDT_PASS_OUTPUT; pass++) {
+        job.pass = pass;
+        if (pass == SDF_EDT_PASS_FORWARD) {
+            for (job.wave = 0; job.wave < nwaves; job.wave++)
+                pfor(uptr, sdf__edtJob, &job, sdf__edtWaveSize(&job));
+        } else if (pass == SDF_EDT_PASS_BACKWARD) {
+            for (job.wave = nwaves-1; job.wave >= 0; job.wave--)
+                pfor(uptr, sdf__edtJob, &job, sdf__edtWaveSize(&job));
+        } else {
+            pfor(uptr, sdf__edtJob, &job, njobs);
+        }
+    }
+}
+
+int sdfBuildDistanceFieldEDT(unsigned char* out, int outstride, float radius,
+                             const unsigned char* img, int width, int height, int stride)
+{
+    unsigned char* temp = (unsigned char*)malloc(sdfEDTTempSize(width, height));
+    if (temp == NULL) return 0;
+    sdfBuildDistanceFieldEDTNoAlloc(out, outstride, radius, img, width, height, stride, temp);
+    free(temp);
+    return 1;
+}
+
+// Fixed point versions of sdfCoverageToDistanceField and the EDT builder. The gradient uses 5793/4096
+// for sqrt(2) and the edge distances come from a table indexed by the gradient direction folded to
+// the first octant and by the coverage, so the per pixel work has no float math.
+#define SDF_FX_DIRS 64			// Gradient directions of the edge table, per octant.
+#define SDF_FX_DIST 256			// Fixed point scale of the edge distances in the table.
+#define SDF_FX_UNIT 4096		// Fixed point scale of the unit gradients in the table, same as SDF_EDT_PT_SCALE.
+#define SDF_FX_INF (1 << 28)	// Squared distance of the pixels which are not seeded, in 1/64 px^2.
+#define SDF_FX_FAR 0xffffffffu	// Squared distance to a pixel which is not a seed.
+
+static short sdf__fxEdge[SDF_FX_DIRS+1][256];	// Edge distance per direction and coverage, 1/SDF_FX_DIST px.
+static short sdf__fxDir[SDF_FX_DIRS+1][2];		// Unit gradient per direction, 1/SDF_FX_UNIT.
+
+static int sdf__fxBuildTables(void)
+{
+    int i, a;
+    for (i = 0; i <= SDF_FX_DIRS; i++) {
+        float gy = (float)i / SDF_FX_DIRS;
+        float glen = 1.0f / sqrtf(1.0f + gy*gy);
+        sdf__fxDir[i][0] = (short)(glen * SDF_FX_UNIT + 0.5f);
+        sdf__fxDir[i][1] = (short)(gy * glen * SDF_FX_UNIT + 0.5f);
+        for (a = 0; a < 256; a++)
+            sdf__fxEdge[i][a] = (short)floorf(sdf__edgedf(glen, gy * glen, (float)a / 255.0f) * SDF_FX_DIST + 0.5f);
+    }
+    return 1;
+}
+
+// The tables are built with floats on the first call. In C++ the static initialization runs once and
+// other threads wait for it, C callers make one fixed point call before using them on several threads.
+static void sdf__fxInit(void)
+{
+#ifdef __cplusplus
+    static const int ready = sdf__fxBuildTables();
+    (void)ready;
+#else
+    static int ready = 0;
+    if (!ready) ready = sdf__fxBuildTables();
+#endif
+}
+
+static void sdf__fxGradient(const unsigned char* img, int stride, int* gx, int* gy)
+{
+    *gx = 4096*((int)img[-stride+1] + (int)img[stride+1] - (int)img[-stride-1] - (int)img[stride-1]) + 5793*((int)img[1] - (int)img[-1]);
+    *gy = 4096*((int)img[stride-1] + (int)img[stride+1] - (int)img[-stride-1] - (int)img[-stride+1]) + 5793*((int)img[stride] - (int)img[-stride]);
+}
+
+// Direction index of the gradient, ax >= ay after the fold.
+static int sdf__fxDirIndex(int ax, int ay)
+{
+    if (ax == 0) return 0;
+    return (ay * SDF_FX_DIRS + (ax >> 1)) / ax;
+}
+
+static unsigned char sdf__coverageToDistanceFixed(const unsigned char* img, int stride)
+{
+    int gx, gy, ax, ay, v;
+
+    // Skip flat areas, same as sdf__coverageToDistance.
+    if (img[0] == 255)
+        return 255;
+    if (img[0] == 0) {
+        int he = img[-1] == 255 || img[1] == 255;
+        int ve = img[-stride] == 255 || img[stride] == 255;
+        if (!he && !ve)
+            return 0;
+    }
+
+    sdf__fxGradient(img, stride, &gx, &gy);
+    // Like sdf__coverageToDistance, a zero horizontal gradient skips the sqrt(2) scale of the distance.
+    if (gx == 0)
+        return img[0];
+    ax = gx < 0 ? -gx : gx;
+    ay = gy < 0 ? -gy : gy;
+    if (ax < ay) {
+        int temp = ax;
+        ax = ay;
+        ay = temp;
+    }
+    // 0.5 - d/sqrt(2) in 1/65536 px, 1/sqrt(2) as 181/256.
+    v = 32768 - sdf__fxEdge[sdf__fxDirIndex(ax, ay)][img[0]] * 181;
+    v = (v * 255) >> 16;
+    return (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+void sdfCoverageToDistanceFieldFixed(unsigned char* out, int outstride,
+                                     const unsigned char* img, int width, int height, int stride)
+{
+    int x, y;
+
+    sdf__fxInit();
+
+    // Zero out borders
+    for (x = 0; x < width; x++)
+        out[x] = 0;
+    for (y = 1; y < height; y++) {
+        out[y*outstride] = 0;
+        out[width-1+y*outstride] = 0;
+    }
+    for (x = 0; x < width; x++)
+        out[x+(height-1)*outstride] = 0;
+
+    for (y = 1; y < height-1; y++) {
+        for (x = 1; x < width-1; x++)
+            out[x+y*outstride] = sdf__coverageToDistanceFixed(&img[x+y*stride], stride);
+    }
+}
+
+// Returns 1 if the pixel is on the antialiased edge, and the offset to the edge point in
+// 1/SDF_FX_UNIT px and the distance to it in 1/SDF_FX_DIST px.
+static int sdf__fxEdgePixel(const unsigned char* img, int stride, int* px, int* py, int* nd)
+{
+    int gx, gy, ax, ay, ux, uy, i, d;
+
+    // Skip flat areas.
+    if (img[0] == 255) return 0;
+    if (img[0] == 0) {
+        int he = img[-1] == 255 || img[1] == 255;
+        int ve = img[-stride] == 255 || img[stride] == 255;
+        if (!he && !ve) return 0;
+    }
+
+    sdf__fxGradient(img, stride, &gx, &gy);
+    if (gx == 0 && gy == 0) return 0;
+    ax = gx < 0 ? -gx : gx;
+    ay = gy < 0 ? -gy : gy;
+    if (ax >= ay) {
+        i = sdf__fxDirIndex(ax, ay);
+        ux = sdf__fxDir[i][0];
+        uy = sdf__fxDir[i][1];
+    } else {
+        i = sdf__fxDirIndex(ay, ax);
+        ux = sdf__fxDir[i][1];
+        uy = sdf__fxDir[i][0];
+    }
+    if (gx < 0) ux = -ux;
+    if (gy < 0) uy = -uy;
+
+    d = sdf__fxEdge[i][img[0]];
+    *px = (ux * d) >> 8;
+    *py = (uy * d) >> 8;
+    *nd = d;
+    return 1;
+}
+
+// Integer version of sdf__edt1d, the squared distances are in 1/64 px^2 so that the parabolas are
+// g[v] + 64*(q-v)^2. The intersections are rounded down, which keeps the envelope exact at the samples.
+static int sdf__fxSep(const int* g, int p, int q)
+{
+    int num = g[q] - g[p] + 64 * (q*q - p*p), den = 128 * (q - p);
+    return num >= 0 ? num / den : -((den - 1 - num) / den);
+}
+
+static void sdf__edt1dFixed(int* f, int n, int step, int* g, int* src, int* v, int* z)
+{
+    int q, k = 0, s;
+
+    for (q = 0; q < n; q++)
+        g[q] = f[q*step];
+
+    v[0] = 0;
+    z[0] = -SDF_FX_INF;
+    z[1] = SDF_FX_INF;
+    for (q = 1; q < n; q++) {
+        s = sdf__fxSep(g, v[k], q);
+        while (s <= z[k]) {
+            k--;
+            s = sdf__fxSep(g, v[k], q);
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = SDF_FX_INF;
+    }
+
+    k = 0;
+    for (q = 0; q < n; q++) {
+        int dq;
+        while (z[k+1] < q) k++;
+        dq = q - v[k];
+        f[q*step] = 64*dq*dq + g[v[k]];
+        src[q] = v[k];
+    }
+}
+
+// Squared distance from pixel x,y to the edge point of seed s in 1/16384 px^2, the components are
+// in 1/128 px and clamped to 256 px so that the sum fits.
+static unsigned int sdf__fxDistSqr(const unsigned int* tpt, int s, int width, int x, int y)
+{
+    int sx = s & 0xffff, sy = s >> 16, dx, dy;
+    unsigned int pt = tpt[sx + sy * width];
+    if (!(pt & SDF_EDT_SEED)) return SDF_FX_FAR;
+    dx = (sx - x) * 128 + ((((short)(pt << 1) >> 1) + 16) >> 5);
+    dy = (sy - y) * 128 + (((short)(pt >> 15) + 16) >> 5);
+    if (dx < -32767) dx = -32767; else if (dx > 32767) dx = 32767;
+    if (dy < -32767) dy = -32767; else if (dy > 32767) dy = 32767;
+    return (unsigned int)(dx*dx) + (unsigned int)(dy*dy);
+}
+
+static void sdf__fxRefine(const unsigned int* tpt, int* tsrc, int width, int x, int y, int k0, int k1, int k2, int k3)
+{
+    int k = x + y * width, best = tsrc[k];
+    int cand[4] = { tsrc[k0], tsrc[k1], tsrc[k2], tsrc[k3] };
+    unsigned int bd = sdf__fxDistSqr(tpt, best, width, x, y);
+    int i;
+    for (i = 0; i < 4; i++) {
+        unsigned int d;
+        if (cand[i] == best) continue;
+        d = sdf__fxDistSqr(tpt, cand[i], width, x, y);
+        if (d < bd) {
+            bd = d;
+            best = cand[i];
+        }
+    }
+    tsrc[k] = best;
+}
+
+// Number of leading entries of the decreasing thresholds t with d <= t[i].
+static int sdf__fxCountBelow(const unsigned int* t, int n, unsigned int d)
+{
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (d <= t[mid]) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Number of leading entries of the increasing thresholds t with d >= t[i].
+static int sdf__fxCountAbove(const unsigned int* t, int n, unsigned int d)
+{
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (d >= t[mid]) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void sdfBuildDistanceFieldEDTFixedNoAlloc(unsigned char* out, int outstride, float radius,
+                                          const unsigned char* img, int width, int height, int stride,
+                                          unsigned char* temp)
+{
+    int x, y, n = width > height ? width : height;
+    int* tdist = (int*)&temp[0];
+    unsigned int* tpt = (unsigned int*)tdist;
+    int* tsrc = tdist + width * height;
+    int* g = tsrc + width * height;
+    int* src = g + n;
+    int* v = src + n;
+    int* z = v + n;
+    int band = (int)((radius + 2.0f) * (radius + 2.0f) * 64.0f);
+    unsigned int tout[127], tin[128];
+
+    sdf__fxInit();
+
+    // Squared distance thresholds of the output values, in 1/16384 px^2. Outside, the value is at
+    // least k+1 when d^2 <= tout[k], inside at least 128+k when d^2 >= tin[k].
+    for (x = 0; x < 127; x++) {
+        float d = 128.0f * radius * (1.0f - 2.0f * (float)(x+1) / 255.0f);
+        tout[x] = (unsigned int)floorf(d * d);
+    }
+    for (x = 0; x < 128; x++) {
+        float d = 128.0f * radius * (2.0f * (float)(x+128) / 255.0f - 1.0f);
+        tin[x] = (unsigned int)ceilf(d * d);
+    }
+
+    // Seed the antialiased pixels with the squared distance to the boundary of the shape, in 1/64 px^2.
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++)
+            tdist[x + y * width] = SDF_FX_INF;
+        if (y == 0 || y == height-1) continue;
+        for (x = 1; x < width-1; x++) {
+            int px, py, dist;
+            if (sdf__fxEdgePixel(&img[x + y * stride], stride, &px, &py, &dist)) {
+                dist = (dist < 0 ? -dist + 16 : dist + 16) >> 5;
+                tdist[x + y * width] = dist * dist;
+            }
+        }
+    }
+
+    // Columns, keeping track of the nearest seed row.
+    for (x = 0; x < width; x++) {
+        sdf__edt1dFixed(&tdist[x], height, width, g, src, v, z);
+        for (y = 0; y < height; y++)
+            tsrc[x + y * width] = src[y];
+    }
+
+    // Rows, the nearest seed pixel is stored as x | y << 16.
+    for (y = 0; y < height; y++) {
+        int* row = &tsrc[y * width];
+        sdf__edt1dFixed(&tdist[y * width], width, 1, g, src, v, z);
+        for (x = 0; x < width; x++)
+            v[x] = src[x] | (row[src[x]] << 16);
+        for (x = 0; x < width; x++)
+            row[x] = v[x];
+    }
+
+    // Store the edge points of the seeds in place of their distances, see sdf__edtPack.
+    for (y = 1; y < height-1; y++) {
+        for (x = 1; x < width-1; x++) {
+            int px, py, dist;
+            if (sdf__fxEdgePixel(&img[x + y * stride], stride, &px, &py, &dist))
+                tpt[x + y * width] = SDF_EDT_SEED | ((unsigned int)px & 0x7fff) | (((unsigned int)py & 0xffff) << 15);
+        }
+    }
+
+    // Refinement sweeps, same as sdf__edtRefineForward and sdf__edtRefineBackward.
+    for (y = 1; y < height-1; y++) {
+        for (x = 1; x < width-1; x++) {
+            int k = x + y * width;
+            if ((tpt[k] & SDF_EDT_SEED) || tdist[k] < band)
+                sdf__fxRefine(tpt, tsrc, width, x, y, k-1, k-width-1, k-width, k-width+1);
+        }
+    }
+    for (y = height-2; y >= 1; y--) {
+        for (x = width-2; x >= 1; x--) {
+            int k = x + y * width;
+            if ((tpt[k] & SDF_EDT_SEED) || tdist[k] < band)
+                sdf__fxRefine(tpt, tsrc, width, x, y, k+1, k+width+1, k+width, k+width-1);
+        }
+    }
+
+    // Map to good range, the pixels outside the band are past the radius.
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            int k = x + y * width, inside;
+            unsigned int d;
+            if (x == 0 || y == 0 || x == width-1 || y == height-1) {
+                out[x+y*outstride] = 0;
+                continue;
+            }
+            inside = img[x+y*stride] > 127;
+            if ((tpt[k] & SDF_EDT_SEED) || tdist[k] < band) {
+                d = sdf__fxDistSqr(tpt, tsrc[k], width, x, y);
+                out[x+y*outstride] = (unsigned char)(inside ? 127 + sdf__fxCountAbove(tin, 128, d) : sdf__fxCountBelow(tout, 127, d));
+            } else {
+                out[x+y*outstride] = (unsigned char)(inside ? 255 : 0);
+            }
+        }
+    }
+}
+
+int sdfBuildDistanceFieldEDTFixed(unsigned char* out, int outstride, float radius,
+                                  const unsigned char* img, int width, int height, int stride)
+{
+    unsigned char* temp = (unsigned char*)malloc(sdfEDTTempSize(width, height));
+    if (temp == NULL) return 0;
+    sdfBuildDistanceFieldEDTFixedNoAlloc(out, outstride, radius, img, width, height, stride, temp);
+    free(temp);
+    return 1;
+}
+
+#define SDF_NB_POINT 1		// Pixel has a nearest edge point.
+#define SDF_NB_QUEUED 2		// Pixel is in the propagation queue.
+
+int sdfNarrowBandTempSize(int width, int height)
+{
+    return width * height * (int)(sizeof(struct SDFpoint) + sizeof(int) + 1);
+}
+
+void sdfBuildDistanceFieldNarrowBandNoAlloc(unsigned char* out, int outstride, float radius,
+                                            const unsigned char* img, int width, int height, int stride,
+                                            unsigned char* temp)
+{
+    static const int dx[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+    static const int dy[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+    int x, y, i, n = width * height, head = 0, count = 0;
+    float band, scale;
+    struct SDFpoint* tpt = (struct SDFpoint*)&temp[0];
+    int* queue = (int*)&temp[n * sizeof(struct SDFpoint)];
+    unsigned char* flags = &temp[n * (sizeof(struct SDFpoint) + sizeof(int))];
+
+    memset(flags, 0, n);
+
+    // Seed the antialiased pixels with the nearest point on the contour.
+    for (y = 1; y < height-1; y++) {
+        for (x = 1; x < width-1; x++) {
+            int k = x + y * width;
+            float gx, gy, d;
+            if (!sdf__edgePixel(&img[x + y * stride], stride, &gx, &gy, &d)) continue;
+            tpt[k].x = x + gx*d;
+            tpt[k].y = y + gy*d;
+            flags[k] = SDF_NB_POINT | SDF_NB_QUEUED;
+            queue[count++] = x | (y << 16);
+        }
+    }
+
+    // Propagate the nearest points to the neighbours until nothing changes within the band.
+    // A pixel is in the queue at most once at a time, so the ring buffer never overflows.
+    band = (radius + 1.0f) * (radius + 1.0f);
+    while (count > 0) {
+        int k;
+        struct SDFpoint pt;
+        x = queue[head] & 0xffff;
+        y = queue[head] >> 16;
+        k = x + y * width;
+        pt = tpt[k];
+        head = head+1 < n ? head+1 : 0;
+        count--;
+        flags[k] &= ~SDF_NB_QUEUED;
+        for (i = 0; i < 8; i++) {
+            int nx = x + dx[i], ny = y + dy[i], kn;
+            struct SDFpoint c;
+            float d;
+            if (nx < 1 || ny < 1 || nx > width-2 || ny > height-2) continue;
+            kn = nx + ny * width;
+            c.x = (float)nx;
+            c.y = (float)ny;
+            d = sdf__distsqr(&c, &pt);
+            if (d > band) continue;
+            if ((flags[kn] & SDF_NB_POINT) && d + SDF_SLACK >= sdf__distsqr(&c, &tpt[kn])) continue;
+            tpt[kn] = pt;
+            flags[kn] |= SDF_NB_POINT;
+            if (!(flags[kn] & SDF_NB_QUEUED)) {
+                flags[kn] |= SDF_NB_QUEUED;
+                queue[head + count < n ? head + count : head + count - n] = nx | (ny << 16);
+                count++;
+            }
+        }
+    }
+
+    // Map to good range, pixels outside the band are either fully inside or outside.
+    scale = 1.0f / radius;
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            int k = x + y * width;
+            int inside = img[x+y*stride] > 127;
+            float d;
+            if (x == 0 || y == 0 || x == width-1 || y == height-1) {
+                out[x+y*outstride] = 0;
+            } else if (flags[k] & SDF_NB_POINT) {
+                struct SDFpoint c = { (float)x, (float)y };
+                d = sqrtf(sdf__distsqr(&c, &tpt[k])) * scale;
+                if (inside) d = -d;
+                out[x+y*outstride] = (unsigned char)(sdf__clamp01(0.5f - d*0.5f) * 255.0f);
+            } else {
+                out[x+y*outstride] = inside ? 255 : 0;
+            }
+        }
+    }
+}
+
+int sdfBuildDistanceFieldNarrowBand(unsigned char* out, int outstride, float radius,
+                                    const unsigned char* img, int width, int height, int stride)
+{
+    unsigned char* temp = (unsigned char*)malloc(sdfNarrowBandTempSize(width, height));
+    if (temp == NULL) return 0;
+    sdfBuildDistanceFieldNarrowBandNoAlloc(out, outstride, radius, img, width, height, stride, temp);
+    free(temp);
+    return 1;
+}
+
+#define SDF_RED 1
+#define SDF_GREEN 2
+#define SDF_BLUE 4
+#define SDF_YELLOW (SDF_RED|SDF_GREEN)
+#define SDF_MAGENTA (SDF_RED|SDF_BLUE)
+#define SDF_CYAN (SDF_GREEN|SDF_BLUE)
+#define SDF_WHITE (SDF_RED|SDF_GREEN|SDF_BLUE)
+#define SDF_CORNER_CROSS 0.14112f	// sin(3 rad), corner angle threshold used by msdfgen.
+
+struct SDFedgeDist {
+    float dist;		// Absolute distance to the edge.
+    float ortho;	// How much the closest point is off the edge ends, used to resolve ties.
+    int edge;		// Index of the edge start point.
+};
+
+static int sdf__isCorner(const float* pts, int prev, int cur, int next)
+{
+    float ax = pts[cur*2+0] - pts[prev*2+0], ay = pts[cur*2+1] - pts[prev*2+1];
+    float bx = pts[next*2+0] - pts[cur*2+0], by = pts[next*2+1] - pts[cur*2+1];
+    float la = sqrtf(ax*ax + ay*ay), lb = sqrtf(bx*bx + by*by);
+    float dot, cross;
+    if (la < 1e-6f || lb < 1e-6f) return 0;
+    dot = (ax*bx + ay*by) / (la*lb);
+    cross = (ax*by - ay*bx) / (la*lb);
+    return dot <= 0.0f || fabsf(cross) > SDF_CORNER_CROSS;
+}
+
+// Colors the edges of each contour, edge i goes from point i to the next point of the contour.
+static void sdf__colorEdges(unsigned char* colors, const float* pts, const unsigned char* smooth,
+                            const int* contours, int ncontours)
+{
+    static const unsigned char palette[3] = { SDF_CYAN, SDF_MAGENTA, SDF_YELLOW };
+    int c, i, start = 0;
+
+    for (c = 0; c < ncontours; c++) {
+        int n = contours[c], ncorners = 0, first = -1, group = 0;
+
+        for (i = 0; i < n; i++) {
+            int prev = start + (i+n-1) % n, next = start + (i+1) % n;
+            if (smooth != NULL && smooth[start+i]) continue;
+            if (sdf__isCorner(pts, prev, start+i, next)) {
+                if (first == -1) first = i;
+                ncorners++;
+            }
+        }
+
+        if (ncorners == 0) {
+            // Smooth contour, all channels see the same edges.
+            for (i = 0; i < n; i++)
+                colors[start+i] = SDF_WHITE;
+        } else if (ncorners == 1) {
+            // Teardrop, split the contour in three starting at the corner.
+            static const unsigned char tear[3] = { SDF_MAGENTA, SDF_WHITE, SDF_YELLOW };
+            for (i = 0; i < n; i++)
+                colors[start + (first+i) % n] = tear[i*3 / n];
+        } else {
+            // Switch color at each corner, make sure that the last group does not match the first one.
+            for (i = 0; i < n; i++) {
+                int k = (first+i) % n;
+                if (i > 0 && (smooth == NULL || !smooth[start+k])) {
+                    int prev = start + (k+n-1) % n, next = start + (k+1) % n;
+                    if (sdf__isCorner(pts, prev, start+k, next))
+                        group++;
+                }
+                if (group == ncorners-1 && group % 3 == 0)
+                    colors[start+k] = SDF_MAGENTA;
+                else
+                    colors[start+k] = palette[group % 3];
+            }
+        }
+        start += n;
+    }
+}
+
+void sdfBuildMultiChannelDistanceFieldNoAlloc(unsigned char* out, int outstride, float radius,
+                                              const float* pts, const unsigned char* smooth,
+                                              const int* contours, int ncontours, int width, int height,
+                                              unsigned char* temp)
+{
+    int c, i, x, y, ch, start;
+    float area = 0.0f, orient, scale = 1.0f / radius;
+    unsigned char* colors = temp;
+
+    sdf__colorEdges(colors, pts, smooth, contours, ncontours);
+
+    // The sign of the total area tells on which side of the edges the inside is.
+    start = 0;
+    for (c = 0; c < ncontours; c++) {
+        for (i = 0; i < contours[c]; i++) {
+            const float* a = &pts[(start+i)*2];
+            const float* b = &pts[(start + (i+1) % contours[c])*2];
+            area += a[0]*b[1] - b[0]*a[1];
+        }
+        start += contours[c];
+    }
+    orient = area < 0.0f ? -1.0f : 1.0f;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            float px = (float)x + 0.5f, py = (float)y + 0.5f;
+            struct SDFedgeDist best[3];
+            float sd[3], med;
+            int winding = 0, inside;
+
+            for (ch = 0; ch < 3; ch++) {
+                best[ch].dist = SDF_BIG;
+                best[ch].ortho = 0.0f;
+                best[ch].edge = -1;
+            }
+
+            start = 0;
+            for (c = 0; c < ncontours; c++) {
+                int n = contours[c];
+                for (i = 0; i < n; i++) {
+                    int ia = start+i, ib = start + (i+1) % n;
+                    float ax = pts[ia*2+0], ay = pts[ia*2+1];
+                    float bx = pts[ib*2+0], by = pts[ib*2+1];
+                    float ex = bx - ax, ey = by - ay, len2 = ex*ex + ey*ey;
+                    float t, dx, dy, d, ortho = 0.0f;
+
+                    // Non-zero winding of the pixel center.
+                    if ((ay <= py) != (by <= py)) {
+                        float ix = ax + (py - ay) * ex / ey;
+                        if (ix > px) winding += by > ay ? 1 : -1;
+                    }
+
+                    if (len2 < 1e-12f) continue;
+                    t = ((px - ax)*ex + (py - ay)*ey) / len2;
+                    if (t < 0.0f || t > 1.0f) {
+                        // Closest point is an end point, measure how much the edge points away from the pixel.
+                        float qx = t < 0.0f ? ax : bx, qy = t < 0.0f ? ay : by;
+                        float ql;
+                        dx = px - qx;
+                        dy = py - qy;
+                        ql = sqrtf(dx*dx + dy*dy);
+                        if (ql > 1e-6f)
+                            ortho = fabsf(dx*ex + dy*ey) / (ql * sqrtf(len2));
+                        d = ql;
+                    } else {
+                        dx = px - (ax + ex*t);
+                        dy = py - (ay + ey*t);
+                        d = sqrtf(dx*dx + dy*dy);
+                    }
+
+                    for (ch = 0; ch < 3; ch++) {
+                        if (!(colors[ia] & (1 << ch))) continue;
+                        if (d < best[ch].dist - 1e-5f || (d < best[ch].dist + 1e-5f && ortho < best[ch].ortho)) {
+                            best[ch].dist = d;
+                            best[ch].ortho = ortho;
+                            best[ch].edge = ia;
+                        }
+                    }
+                }
+                start += n;
+            }
+            inside = winding != 0;
+
+            // Pseudo-distance, edges are extended beyond their ends which keeps the corners sharp.
+            for (ch = 0; ch < 3; ch++) {
+                int ia = best[ch].edge, ib, s;
+                float ax, ay, ex, ey, len, cross, t;
+                if (ia == -1) {
+                    sd[ch] = inside ? SDF_BIG : -SDF_BIG;
+                    continue;
+                }
+                // Find the contour of the edge to wrap the end point.
+                for (c = 0, s = 0; s + contours[c] <= ia; c++)
+                    s += contours[c];
+                ib = s + (ia - s + 1) % contours[c];
+                ax = pts[ia*2+0]; ay = pts[ia*2+1];
+                ex = pts[ib*2+0] - ax; ey = pts[ib*2+1] - ay;
+                len = sqrtf(ex*ex + ey*ey);
+                cross = (ex*(py - ay) - ey*(px - ax)) / len;
+                t = ((px - ax)*ex + (py - ay)*ey) / (len*len);
+                sd[ch] = cross < 0.0f ? -best[ch].dist : best[ch].dist;
+                if ((t < 0.0f || t > 1.0f) && fabsf(cross) < best[ch].dist)
+                    sd[ch] = cross;
+                sd[ch] *= orient;
+            }
+
+            // Make sure the median agrees with the fill rule.
+            med = fmaxf(fminf(sd[0], sd[1]), fminf(fmaxf(sd[0], sd[1]), sd[2]));
+            if ((med > 0.0f) != inside && med != 0.0f) {
+                sd[0] = -sd[0];
+                sd[1] = -sd[1];
+                sd[2] = -sd[2];
+            }
+
+            for (ch = 0; ch < 3; ch++)
+                out[x*3+ch + y*outstride] = (unsigned char)(sdf__clamp01(0.5f + sd[ch]*scale*0.5f) * 255.0f);
+        }
+    }
+}
+
+int sdfBuildMultiChannelDistanceField(unsigned char* out, int outstride, float radius,
+                                      const float* pts, const unsigned char* smooth,
+                                      const int* contours, int ncontours, int width, int height)
+{
+    int c, npts = 0;
+    unsigned char* temp;
+    for (c = 0; c < ncontours; c++)
+        npts += contours[c];
+    temp = (unsigned char*)malloc(npts > 0 ? npts : 1);
+    if (temp == NULL) return 0;
+    sdfBuildMultiChannelDistanceFieldNoAlloc(out, outstride, radius, pts, smooth, contours, ncontours, width, height, temp);
+    free(temp);
+    return 1;
+}
+
 #endif //SDF_IMPLEMENTATION
\ No newline at end of file
@@ -28,6 +28,7 @@ attribute float a_alpha;
 attribute float a_rotation;
 
 uniform mat4 u_proj;
+uniform vec2 u_offset;
 
 varying vec2 v_uv;
 varying float v_alpha;
@@ -37,10 +38,10 @@ void main() {
         float st = sin(a_rotation);
         float ct = cos(a_rotation);
 
-        // rotates first around +z-axis (0,0,1) and then translates by (tx,ty,0)
+        // rotates first around +z-axis (0,0,1) and then translates by (tx,ty,0), shadows are offset on screen
         vec4 p = vec4(
-            a_position.x * ct - a_position.y * st + a_screenPosition.x,
-            a_position.x * st + a_position.y * ct + a_screenPosition.y,
+            a_position.x * ct - a_position.y * st + a_screenPosition.x + u_offset.x,
+            a_position.x * st + a_position.y * ct + a_screenPosition.y + u_offset.y,
             0.0, 1.0
         );
 
@@ -67,6 +68,8 @@ precision mediump float;
 
 uniform sampler2D u_tex;
 uniform LOWP vec3 u_color;
+// x: edge moved out, y: extra smoothing, in distance field units
+uniform vec2 u_effect;
 
 varying vec2 v_uv;
 varying float v_alpha;
@@ -76,7 +79,7 @@ const float tint = 1.8;
 const float sdf = 0.8;
 
 float contour(in float d, in float w, in float off) {
-    return smoothstep(off - w, off + w, d);
+    return smoothstep(off - w - u_effect.y, off + w + u_effect.y, d);
 }
 
 float sample(in vec2 uv, float w, in float off) {
@@ -108,7 +111,7 @@ void main(void) {
     }
 
     float distance = texture2D(u_tex, v_uv).a;
-    float alpha = sampleAlpha(v_uv, distance, sdf) * tint;
+    float alpha = sampleAlpha(v_uv, distance, sdf - u_effect.x) * tint;
     alpha = pow(alpha, 1.0 / gamma);
 
     gl_FragColor = vec4(u_color, v_alpha * alpha);
@@ -116,6 +119,50 @@ void main(void) {
 
 )END";
 
+USE_VARIABLE static const GLchar* msdfFragShaderSrc = R"END(
+#extension GL_OES_standard_derivatives : enable
+
+#ifdef GL_ES
+precision mediump float;
+#define LOWP lowp
+#else
+#define LOWP
+#endif
+
+uniform sampler2D u_tex;
+uniform LOWP vec3 u_color;
+// x: edge moved out, y: extra smoothing, in distance field units
+uniform vec2 u_effect;
+
+varying vec2 v_uv;
+varying float v_alpha;
+
+float median(float r, float g, float b) {
+    return max(min(r, g), min(max(r, g), b));
+}
+
+void main(void) {
+    if (v_alpha == 0.0) {
+        discard;
+    }
+
+    vec3 msdf = texture2D(u_tex, v_uv).rgb;
+    float distance = median(msdf.r, msdf.g, msdf.b);
+
+#ifdef GL_OES_standard_derivatives
+    float w = 0.7 * fwidth(distance);
+#else
+    float w = 0.1;
+#endif
+
+    float edge = 0.5 - u_effect.x;
+    float alpha = smoothstep(edge - w - u_effect.y, edge + w + u_effect.y, distance);
+
+    gl_FragColor = vec4(u_color, v_alpha * alpha);
+}
+
+)END";
+
 USE_VARIABLE static const GLchar* defaultFragShaderSrc = R"END(
 
 #ifdef GL_ES
@@ -0,0 +1,222 @@
+//
+// Runs every variant of the pixel kernels picked by fons__initKernels that the running CPU
+// supports, and sdfCoverageToDistanceFieldISA for each instruction set, and checks that their
+// output is the same as the scalar kernel's bit for bit.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define FONS_USE_COVERAGE_RASTERIZER
+#define FONTSTASH_IMPLEMENTATION
+#include "fontstash.h"
+#include "test.h"
+
+#define MAX_W 80
+
+// Random bytes with runs of empty and full pixels, like glyph rows.
+static void fillRow(unsigned char* row, int w)
+{
+    int x = 0;
+    while (x < w) {
+        int run = 1 + rnd() % 24;
+        int kind = rnd() % 3;
+        for (; run > 0 && x < w; run--, x++)
+            row[x] = kind == 0 ? 0 : kind == 1 ? 255 : (unsigned char)rnd();
+    }
+}
+
+typedef void (*BlurRowStepFunc)(unsigned char* row, int* z, int w, int alpha);
+typedef void (*GrowRowFunc)(unsigned char* dst, const unsigned char* src, int w, const unsigned char* lut, int limit);
+typedef int (*DecodeASCIIFunc)(const unsigned char* src, int n, unsigned int* dst);
+typedef float (*AccumulateRowFunc)(const float* acc, unsigned char* dst, int w, float sum);
+
+static void testBlurRowStep(const char* name, BlurRowStepFunc fn)
+{
+    static const int alphas[] = { 1, 977, 11470, 32768, 52000, 65535 };
+    unsigned char row[MAX_W], rowRef[MAX_W];
+    int z[MAX_W], zRef[MAX_W];
+    int w, a, step, x;
+
+    for (w = 1; w < MAX_W; w++) {
+        for (a = 0; a < (int)(sizeof(alphas) / sizeof(alphas[0])); a++) {
+            for (x = 0; x < w; x++)
+                z[x] = zRef[x] = (int)(rnd() % (256 << ZPREC));
+            for (step = 0; step < 4; step++) {
+                fillRow(row, w);
+                memcpy(rowRef, row, w);
+                fons__blurRowStepScalar(rowRef, zRef, w, alphas[a]);
+                fn(row, z, w, alphas[a]);
+                CHECK(memcmp(row, rowRef, w) == 0 && memcmp(z, zRef, w * sizeof(int)) == 0,
+                      "%s w %d alpha %d step %d", name, w, alphas[a], step);
+            }
+        }
+    }
+}
+
+static void testGrowRow(const char* name, GrowRowFunc fn)
+{
+    unsigned char lut[256], src[MAX_W], dst[MAX_W+1], dstRef[MAX_W+1];
+    int blur, limit, w, i, n;
+
+    for (blur = 1; blur <= 20; blur++) {
+        limit = 255 / blur;
+        for (i = 0; i < 256; i++)
+            lut[i] = (unsigned char)(i < limit ? i * 255 / limit : 255);
+        for (w = 1; w < MAX_W; w++) {
+            for (n = 0; n < 8; n++) {
+                fillRow(src, w);
+                memset(dst, 0xcd, sizeof(dst));
+                memset(dstRef, 0xcd, sizeof(dstRef));
+                fons__growRowScalar(dstRef, src, w, lut, limit);
+                fn(dst, src, w, lut, limit);
+                CHECK(memcmp(dst, dstRef, sizeof(dst)) == 0, "%s w %d blur %d", name, w, blur);
+            }
+        }
+    }
+}
+
+static void testDecodeASCII(const char* name, DecodeASCIIFunc fn)
+{
+    unsigned char src[MAX_W];
+    unsigned int dst[MAX_W], dstRef[MAX_W];
+    int n, k, i, count, countRef;
+
+    for (n = 0; n < MAX_W; n++) {
+        for (k = 0; k < 16; k++) {
+            for (i = 0; i < n; i++)
+                src[i] = (unsigned char)(rnd() % 0x80);
+            // Bytes of a multibyte sequence stop the ASCII run.
+            if (n > 0 && k > 0)
+                src[rnd() % n] = (unsigned char)(0x80 | rnd());
+            countRef = fons__decodeASCIIScalar(src, n, dstRef);
+            count = fn(src, n, dst);
+            CHECK(count == countRef && memcmp(dst, dstRef, count * sizeof(unsigned int)) == 0,
+                  "%s n %d count %d expected %d", name, n, count, countRef);
+        }
+    }
+}
+
+static void testAccumulateRow(const char* name, AccumulateRowFunc fn)
+{
+    float acc[MAX_W];
+    unsigned char dst[MAX_W], dstRef[MAX_W];
+    float sum, sumRef, start;
+    int w, n, x;
+
+    for (w = 1; w < MAX_W; w++) {
+        for (n = 0; n < 16; n++) {
+            start = ((int)(rnd() % 2001) - 1000) / 1000.0f;
+            for (x = 0; x < w; x++)
+                acc[x] = rnd() % 4 == 0 ? ((int)(rnd() % 2001) - 1000) / 3000.0f : 0.0f;
+            sumRef = fons__accumulateRowScalar(acc, dstRef, w, start);
+            sum = fn(acc, dst, w, start);
+            CHECK(memcmp(dst, dstRef, w) == 0 && memcmp(&sum, &sumRef, sizeof(float)) == 0,
+                  "%s w %d sum %g expected %g", name, w, sum, sumRef);
+        }
+    }
+}
+
+// Antialiased disc with noise, so that the images have flat areas, edges and noisy gradients.
+static void fillImage(unsigned char* img, int w, int h, int stride)
+{
+    float cx = w * 0.5f, cy = h * 0.5f, r = (w < h ? w : h) * 0.35f;
+    int x, y;
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < stride; x++) {
+            float dx = x + 0.5f - cx, dy = y + 0.5f - cy;
+            float d = r - sqrtf(dx*dx + dy*dy) + 0.5f;
+            int v = d <= 0.0f ? 0 : d >= 1.0f ? 255 : (int)(d * 255.0f);
+            if (rnd() % 8 == 0)
+                v = rnd() % 256;
+            img[y*stride + x] = (unsigned char)v;
+        }
+    }
+}
+
+static void testCoverageISA(const char* name, int isa)
+{
+    static const int sizes[] = { 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 64, 67 };
+    const int nsizes = (int)(sizeof(sizes) / sizeof(sizes[0]));
+    unsigned char* img = (unsigned char*)malloc(80 * 80);
+    unsigned char* out = (unsigned char*)malloc(80 * 80);
+    unsigned char* outRef = (unsigned char*)malloc(80 * 80);
+    int i, j, w, h, stride, outstride, ok;
+
+    for (i = 0; i < nsizes; i++) {
+        for (j = 0; j < nsizes; j++) {
+            w = sizes[i];
+            h = sizes[j];
+            stride = w + rnd() % 8;
+            outstride = w + rnd() % 8;
+            fillImage(img, w, h, stride);
+            memset(out, 0xcd, 80 * 80);
+            memset(outRef, 0xcd, 80 * 80);
+            sdfCoverageToDistanceFieldISA(outRef, outstride, img, w, h, stride, SDF_ISA_SCALAR);
+            ok = sdfCoverageToDistanceFieldISA(out, outstride, img, w, h, stride, isa);
+            CHECK(ok && memcmp(out, outRef, 80 * 80) == 0, "%s %dx%d", name, w, h);
+        }
+    }
+
+    free(img);
+    free(out);
+    free(outRef);
+}
+
+int main()
+{
+    int cpu = fons__cpuFeatures();
+    int ntested = 0;
+    FONSkernels k;
+    FONS_NOTUSED(cpu);
+
+    // The kernels picked for this CPU.
+    fons__initKernels(&k);
+    testBlurRowStep("blurRowStep", k.blurRowStep);
+    testGrowRow("growRow", k.growRow);
+    testDecodeASCII("decodeASCII", k.decodeASCII);
+    testAccumulateRow("accumulateRow", k.accumulateRow);
+    testCoverageISA("coverage", k.sdfIsa);
+    ntested += 5;
+
+#if defined(FONS_SSE2)
+    if (cpu & FONS_CPU_SSE2) {
+        testBlurRowStep("blurRowStepSSE2", fons__blurRowStepSSE2);
+        testGrowRow("growRowSSE2", fons__growRowSSE2);
+        testDecodeASCII("decodeASCIISSE2", fons__decodeASCIISSE2);
+        testAccumulateRow("accumulateRowSSE2", fons__accumulateRowSSE2);
+        ntested += 4;
+    }
+#	if defined(FONS_SSE41)
+    if (cpu & FONS_CPU_SSE41) {
+        testBlurRowStep("blurRowStepSSE41", fons__blurRowStepSSE41);
+        ntested++;
+    }
+#	endif
+#elif defined(FONS_NEON)
+    if (cpu & FONS_CPU_NEON) {
+        testBlurRowStep("blurRowStepNEON", fons__blurRowStepNEON);
+        testGrowRow("growRowNEON", fons__growRowNEON);
+        testDecodeASCII("decodeASCIINEON", fons__decodeASCIINEON);
+        testAccumulateRow("accumulateRowNEON", fons__accumulateRowNEON);
+        ntested += 4;
+    }
+#endif
+
+    if (sdfHasISA(SDF_ISA_SSE2) && (cpu & FONS_CPU_SSE2)) {
+        testCoverageISA("coverage SSE2", SDF_ISA_SSE2);
+        ntested++;
+    }
+    if (sdfHasISA(SDF_ISA_AVX2) && (cpu & FONS_CPU_AVX2)) {
+        testCoverageISA("coverage AVX2", SDF_ISA_AVX2);
+        ntested++;
+    }
+    if (sdfHasISA(SDF_ISA_NEON) && (cpu & FONS_CPU_NEON)) {
+        testCoverageISA("coverage NEON", SDF_ISA_NEON);
+        ntested++;
+    }
+
+    printf("%d kernels checked, %d failures\n", ntested, nfailed);
+    return nfailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+//
+// Times the fixed point distance field kernels against the float ones on glyphs, built without
+// SIMD so that both run as plain scalar code. Usage: sdf_bench font.ttf [repeats]
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+
+#define FONS_NO_SIMD
+#define FONTSTASH_IMPLEMENTATION
+#include "fontstash.h"
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char* argv[])
+{
+    static const float sizes[] = { 12.0f, 20.0f, 40.0f, 100.0f, 220.0f };
+    static const int radii[] = { 2, 4, 8, 16 };
+    const char* chars = "@gWi&So";
+    double coverageFloat = 0.0, coverageFixed = 0.0, edtFloat = 0.0, edtFixed = 0.0, t;
+    long npixels = 0;
+    int i, j, c, k, pad, x0, y0, x1, y1, w, h, repeats = 1;
+    unsigned char *img, *out, *temp;
+    FONSparams params;
+    FONScontext* stash;
+    stbtt_fontinfo* font;
+    int fontId;
+
+    if (argc < 2) {
+        printf("usage: %s font.ttf [repeats]\n", argv[0]);
+        return 2;
+    }
+    if (argc > 2)
+        repeats = fons__maxi(atoi(argv[2]), 1);
+    memset(&params, 0, sizeof(params));
+    params.width = 64;
+    params.height = 64;
+    stash = fonsCreateInternal(&params);
+    fontId = fonsAddFont(stash, "serif", argv[1]);
+    if (fontId == FONS_INVALID) {
+        printf("could not load %s\n", argv[1]);
+        fonsDeleteInternal(stash);
+        return 2;
+    }
+    font = &stash->fonts[fontId]->font.font;
+
+    for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        float scale = stbtt_ScaleForPixelHeight(font, sizes[i]);
+        for (j = 0; j < (int)(sizeof(radii) / sizeof(radii[0])); j++) {
+            for (c = 0; chars[c]; c++) {
+                pad = radii[j] + 2;
+                stbtt_GetCodepointBitmapBox(font, chars[c], scale, scale, &x0, &y0, &x1, &y1);
+                w = x1 - x0 + pad*2;
+                h = y1 - y0 + pad*2;
+                img = (unsigned char*)calloc(w * h, 1);
+                out = (unsigned char*)malloc(w * h);
+                temp = (unsigned char*)malloc(sdfEDTTempSize(w, h));
+                stash->nscratch = 0;
+                stbtt_MakeCodepointBitmap(font, &img[pad + pad*w], x1 - x0, y1 - y0, w, scale, scale, chars[c]);
+
+                t = now();
+                for (k = 0; k < repeats; k++)
+                    sdfCoverageToDistanceField(out, w, img, w, h, w);
+                coverageFloat += now() - t;
+                t = now();
+                for (k = 0; k < repeats; k++)
+                    sdfCoverageToDistanceFieldFixed(out, w, img, w, h, w);
+                coverageFixed += now() - t;
+                t = now();
+                for (k = 0; k < repeats; k++)
+                    sdfBuildDistanceFieldEDTNoAlloc(out, w, (float)radii[j], img, w, h, w, temp);
+                edtFloat += now() - t;
+                t = now();
+                for (k = 0; k < repeats; k++)
+                    sdfBuildDistanceFieldEDTFixedNoAlloc(out, w, (float)radii[j], img, w, h, w, temp);
+                edtFixed += now() - t;
+                npixels += (long)w * h * repeats;
+
+                free(img);
+                free(out);
+                free(temp);
+            }
+        }
+    }
+
+    printf("coverage: float %.2f ns/px, fixed %.2f ns/px, %.2fx\n",
+           coverageFloat * 1e9 / npixels, coverageFixed * 1e9 / npixels, coverageFloat / coverageFixed);
+    printf("EDT: float %.2f ns/px, fixed %.2f ns/px, %.2fx\n",
+           edtFloat * 1e9 / npixels, edtFixed * 1e9 / npixels, edtFloat / edtFixed);
+
+    fonsDeleteInternal(stash);
+    return 0;
+}
@@ -0,0 +1,84 @@
+//
+// Reduced resolution distance field glyphs stay inside their atlas rects, also the large ones whose
+// full size tile and temporaries don't fit the scratch buffer, on an atlas just big enough for them.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define FONTSTASH_IMPLEMENTATION
+#include "fontstash.h"
+#include "test.h"
+
+// Non-zero texels outside of the white rect and of every glyph rect of the font.
+static int strayTexels(FONScontext* stash, int font)
+{
+    FONSfont* f = stash->fonts[font];
+    int x, y, i, inside, n = 0;
+
+    for (y = 0; y < stash->params.height; y++) {
+        for (x = 0; x < stash->params.width; x++) {
+            if (stash->texData[x + y * stash->params.width] == 0 || (x < 2 && y < 2))
+                continue;
+            inside = 0;
+            for (i = 0; i < f->nglyphs && !inside; i++) {
+                FONSglyph* g = &f->glyphs[i];
+                inside = x >= g->x0 && x < g->x1 && y >= g->y0 && y < g->y1;
+            }
+            n += !inside;
+        }
+    }
+    return n;
+}
+
+static void testDownsample(const char* path, int width, int height, float size, int blur, int downsample, const char* text,
+                           int fits)
+{
+    FONSparams params;
+    FONScontext* stash;
+    int font, n;
+
+    memset(&params, 0, sizeof(params));
+    params.width = width;
+    params.height = height;
+    stash = fonsCreateInternal(&params);
+    font = fonsAddFont(stash, "serif", path);
+    fonsSetFont(stash, font);
+    fonsSetSize(stash, size);
+    fonsSetBlurType(stash, FONS_EFFECT_DISTANCE_FIELD);
+    fonsSetBlur(stash, (float)blur);
+    fonsSetSDFDownsample(stash, downsample);
+    fonsDrawText(stash, 0, 0, text, NULL, 1);
+
+    CHECK(!fits || stash->fonts[font]->nglyphs > 0, "%dx%d %.0fpx blur %d ds %d: no glyph added", width, height, size, blur, downsample);
+    n = strayTexels(stash, font);
+    CHECK(n == 0, "%dx%d %.0fpx blur %d ds %d: %d texels outside of the glyphs", width, height, size, blur, downsample, n);
+
+    fonsDeleteInternal(stash);
+}
+
+int main(int argc, char* argv[])
+{
+    static const float sizes[] = { 24.0f, 72.0f, 120.0f, 180.0f };
+    static const int blurs[] = { 2, 8, 16 };
+    int i, j, ds;
+
+    if (argc < 2) {
+        printf("usage: %s font.ttf\n", argv[0]);
+        return 2;
+    }
+
+    // The 120px W at blur 8 doesn't fit the scratch buffer downsampled, at full size it is too big for
+    // an 80x60 atlas that would hold the downsampled glyph.
+    testDownsample(argv[1], 512, 512, 120.0f, 8, 2, "W", 1);
+    testDownsample(argv[1], 80, 60, 120.0f, 8, 2, "W", 0);
+
+    for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+        for (j = 0; j < (int)(sizeof(blurs) / sizeof(blurs[0])); j++)
+            for (ds = 2; ds <= 4; ds++)
+                testDownsample(argv[1], 1024, 1024, sizes[i], blurs[j], ds, "W@gM", 1);
+
+    printf("%d failures\n", nfailed);
+    return nfailed == 0 ? 0 : 1;
+}
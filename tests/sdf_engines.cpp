@@ -0,0 +1,125 @@
+//
+// Times the distance field engines on a string at several sizes and spreads, and compares their atlas
+// to the one of the EDT engine. Built with FONS_USE_FREETYPE it includes the FreeType sdf renderer.
+// Usage: sdf_engines font.ttf [repeats]
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+
+#define FONTSTASH_IMPLEMENTATION
+#include "fontstash.h"
+
+#define ATLAS_SIZE 1024
+
+static const char* text = "The quick brown fox jumps over @&%";
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static FONScontext* createContext(const char* path, int engine, float size, int spread)
+{
+    FONSparams params;
+    FONScontext* stash;
+    int font;
+
+    memset(&params, 0, sizeof(params));
+    params.width = ATLAS_SIZE;
+    params.height = ATLAS_SIZE;
+    stash = fonsCreateInternal(&params);
+    font = fonsAddFont(stash, "serif", path);
+    if (font == FONS_INVALID) {
+        fonsDeleteInternal(stash);
+        return NULL;
+    }
+    fonsSetFont(stash, font);
+    fonsSetSize(stash, size);
+    fonsSetBlurType(stash, FONS_EFFECT_DISTANCE_FIELD);
+    fonsSetBlur(stash, (float)spread);
+    fonsSetSDFEngine(stash, engine);
+    return stash;
+}
+
+// Microseconds to rasterize the string into an empty atlas.
+static double timeEngine(FONScontext* stash, int repeats)
+{
+    double t = now();
+    int i;
+    for (i = 0; i < repeats; i++) {
+        fonsResetAtlas(stash, ATLAS_SIZE, ATLAS_SIZE, 1);
+        fonsDrawText(stash, 0, 0, text, NULL, 1);
+    }
+    return (now() - t) * 1e6 / repeats;
+}
+
+// Mean and largest difference of the texels that are set in either atlas.
+static void compareAtlas(const unsigned char* a, const unsigned char* b, float* mean, int* max)
+{
+    long sum = 0, n = 0;
+    int i, d;
+    *max = 0;
+    for (i = 0; i < ATLAS_SIZE * ATLAS_SIZE; i++) {
+        if (a[i] == 0 && b[i] == 0) continue;
+        d = abs(a[i] - b[i]);
+        sum += d;
+        n++;
+        *max = d > *max ? d : *max;
+    }
+    *mean = n > 0 ? (float)sum / n : 0.0f;
+}
+
+int main(int argc, char* argv[])
+{
+    static const float sizes[] = { 24.0f, 48.0f, 96.0f };
+    static const int spreads[] = { 4, 8 };
+    static const int engines[] = { FONS_SDF_SWEEP, FONS_SDF_EDT, FONS_SDF_NARROW_BAND, FONS_SDF_FIXED,
+#ifdef FONS_USE_FREETYPE
+                                   FONS_SDF_FREETYPE,
+#endif
+                                 };
+    static const char* names[] = { "sweep", "edt", "narrow", "fixed", "freetype" };
+    const int nengines = (int)(sizeof(engines) / sizeof(engines[0]));
+    FONScontext* stashes[5];
+    double us[5];
+    float mean;
+    int i, j, e, max, repeats = 20;
+
+    if (argc < 2) {
+        printf("usage: %s font.ttf [repeats]\n", argv[0]);
+        return 2;
+    }
+    if (argc > 2)
+        repeats = fons__maxi(atoi(argv[2]), 1);
+
+    printf("us per string, and mean/max difference to edt\n");
+    printf("size spread");
+    for (e = 0; e < nengines; e++)
+        printf(" %17s", names[e]);
+    printf("\n");
+
+    for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        for (j = 0; j < (int)(sizeof(spreads) / sizeof(spreads[0])); j++) {
+            for (e = 0; e < nengines; e++) {
+                stashes[e] = createContext(argv[1], engines[e], sizes[i], spreads[j]);
+                if (stashes[e] == NULL) {
+                    printf("could not load %s\n", argv[1]);
+                    return 2;
+                }
+                us[e] = timeEngine(stashes[e], repeats);
+            }
+            printf("%4.0f %6d", sizes[i], spreads[j]);
+            for (e = 0; e < nengines; e++) {
+                compareAtlas(stashes[e]->texData, stashes[1]->texData, &mean, &max);
+                printf(" %7.0f %5.2f/%3d", us[e], mean, max);
+            }
+            printf("\n");
+            for (e = 0; e < nengines; e++)
+                fonsDeleteInternal(stashes[e]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+//
+// Error bounds of the fixed point distance field kernels against the float ones, and of both EDTs
+// against a brute force nearest edge reference, on glyphs of several sizes and radii.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define FONTSTASH_IMPLEMENTATION
+#include "fontstash.h"
+#include "test.h"
+
+#define COVERAGE_MAX_ERROR 1	// Fixed against float coverage kernel.
+#define EDT_MAX_ERROR 9			// Fixed against float EDT.
+#define REF_MAX_EXTRA 1			// Fixed EDT error against the reference over the float one, for the glyphs of a size and radius.
+
+// All 3x3 neighbourhoods mixing empty, full and partial pixels.
+static void testNeighbourhoods()
+{
+    unsigned char img[9], out[9], outRef[9];
+    int i, j, d, worst = 0;
+
+    for (i = 0; i < 1000000; i++) {
+        for (j = 0; j < 9; j++) {
+            int k = rnd() % 4;
+            img[j] = (unsigned char)(k == 0 ? 0 : k == 1 ? 255 : rnd() % 256);
+        }
+        sdfCoverageToDistanceFieldISA(outRef, 3, img, 3, 3, 3, SDF_ISA_SCALAR);
+        sdfCoverageToDistanceFieldFixed(out, 3, img, 3, 3, 3);
+        d = abs(out[4] - outRef[4]);
+        worst = d > worst ? d : worst;
+    }
+    CHECK(worst <= COVERAGE_MAX_ERROR, "coverage 3x3: max error %d", worst);
+}
+
+// Distance field value of the nearest edge point, as sdfBuildDistanceFieldEDT encodes it.
+static void buildReference(unsigned char* out, const unsigned char* img, int w, int h, float radius)
+{
+    float* pts = (float*)malloc(w * h * 2 * sizeof(float));
+    float gx, gy, d, dx, dy, best;
+    int x, y, i, npts = 0;
+
+    for (y = 1; y < h-1; y++) {
+        for (x = 1; x < w-1; x++) {
+            if (sdf__edgePixel(&img[x + y*w], w, &gx, &gy, &d)) {
+                pts[npts*2+0] = x + gx*d;
+                pts[npts*2+1] = y + gy*d;
+                npts++;
+            }
+        }
+    }
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            best = 1e30f;
+            for (i = 0; i < npts; i++) {
+                dx = pts[i*2+0] - x;
+                dy = pts[i*2+1] - y;
+                best = fons__minf(best, dx*dx + dy*dy);
+            }
+            d = sqrtf(best) / radius;
+            if (img[x + y*w] > 127) d = -d;
+            out[x + y*w] = (unsigned char)(sdf__clamp01(0.5f - d*0.5f) * 255.0f);
+        }
+    }
+    free(pts);
+}
+
+static int maxError(const unsigned char* a, const unsigned char* b, int w, int h)
+{
+    int x, y, d, m = 0;
+    // The outermost pixels have no neighbours to find edges from.
+    for (y = 1; y < h-1; y++) {
+        for (x = 1; x < w-1; x++) {
+            d = abs(a[x + y*w] - b[x + y*w]);
+            m = d > m ? d : m;
+        }
+    }
+    return m;
+}
+
+static void testGlyphs(FONScontext* stash, const stbtt_fontinfo* font)
+{
+    static const float sizes[] = { 12.0f, 20.0f, 40.0f, 100.0f };
+    static const int radii[] = { 2, 4, 8, 16 };
+    const char* chars = "@gWi&So";
+    int i, j, c, pad, x0, y0, x1, y1, w, h, d, maxFloat, maxFixed;
+    unsigned char *img, *out, *outRef, *ref, *temp;
+
+    for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        float scale = stbtt_ScaleForPixelHeight(font, sizes[i]);
+        for (j = 0; j < (int)(sizeof(radii) / sizeof(radii[0])); j++) {
+            maxFloat = 0;
+            maxFixed = 0;
+            for (c = 0; chars[c]; c++) {
+                pad = radii[j] + 2;
+                stbtt_GetCodepointBitmapBox(font, chars[c], scale, scale, &x0, &y0, &x1, &y1);
+                w = x1 - x0 + pad*2;
+                h = y1 - y0 + pad*2;
+                img = (unsigned char*)calloc(w * h, 1);
+                out = (unsigned char*)malloc(w * h);
+                outRef = (unsigned char*)malloc(w * h);
+                ref = (unsigned char*)malloc(w * h);
+                temp = (unsigned char*)malloc(sdfEDTTempSize(w, h));
+                stash->nscratch = 0;
+                stbtt_MakeCodepointBitmap(font, &img[pad + pad*w], x1 - x0, y1 - y0, w, scale, scale, chars[c]);
+
+                sdfCoverageToDistanceFieldISA(outRef, w, img, w, h, w, SDF_ISA_SCALAR);
+                sdfCoverageToDistanceFieldFixed(out, w, img, w, h, w);
+                d = maxError(out, outRef, w, h);
+                CHECK(d <= COVERAGE_MAX_ERROR, "coverage '%c' %.0fpx: max error %d", chars[c], sizes[i], d);
+
+                sdfBuildDistanceFieldEDTNoAlloc(outRef, w, (float)radii[j], img, w, h, w, temp);
+                sdfBuildDistanceFieldEDTFixedNoAlloc(out, w, (float)radii[j], img, w, h, w, temp);
+                d = maxError(out, outRef, w, h);
+                CHECK(d <= EDT_MAX_ERROR, "EDT '%c' %.0fpx r %d: max error %d", chars[c], sizes[i], radii[j], d);
+
+                buildReference(ref, img, w, h, (float)radii[j]);
+                maxFloat = fons__maxi(maxFloat, maxError(outRef, ref, w, h));
+                maxFixed = fons__maxi(maxFixed, maxError(out, ref, w, h));
+
+                // In place gives the same field.
+                sdfBuildDistanceFieldEDTFixedNoAlloc(img, w, (float)radii[j], img, w, h, w, temp);
+                CHECK(memcmp(img, out, w * h) == 0, "EDT '%c' %.0fpx r %d: in place differs", chars[c], sizes[i], radii[j]);
+
+                free(img);
+                free(out);
+                free(outRef);
+                free(ref);
+                free(temp);
+            }
+            CHECK(maxFixed <= maxFloat + REF_MAX_EXTRA, "EDT %.0fpx r %d: max error against reference %d, float %d",
+                  sizes[i], radii[j], maxFixed, maxFloat);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    FONSparams params;
+    FONScontext* stash;
+    int font;
+
+    seed = 38;
+    if (argc < 2) {
+        printf("usage: %s font.ttf\n", argv[0]);
+        return 2;
+    }
+    memset(&params, 0, sizeof(params));
+    params.width = 64;
+    params.height = 64;
+    stash = fonsCreateInternal(&params);
+    font = fonsAddFont(stash, "serif", argv[1]);
+    if (font == FONS_INVALID) {
+        printf("could not load %s\n", argv[1]);
+        fonsDeleteInternal(stash);
+        return 2;
+    }
+
+    testNeighbourhoods();
+    testGlyphs(stash, &stash->fonts[font]->font.font);
+
+    fonsDeleteInternal(stash);
+    printf("%d failures\n", nfailed);
+    return nfailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+//
+// Checks the vectorized sdfCoverageToDistanceField kernels against the scalar one within one level,
+// on random images and on glyphs, and the FONS_EFFECT_DISTANCE_FIELD_FAST glyphs written by them
+// straight to the atlas.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define FONTSTASH_IMPLEMENTATION
+#include "fontstash.h"
+#include "test.h"
+
+#define MAX_SIZE 160
+
+// Largest difference of two images, -1 if the bytes outside of them differ.
+static int maxDiff(const unsigned char* a, const unsigned char* b, int w, int h, int stride, int size)
+{
+    int x, y, d, m = 0;
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            d = abs(a[y*stride + x] - b[y*stride + x]);
+            m = d > m ? d : m;
+        }
+        if (memcmp(&a[y*stride + w], &b[y*stride + w], (y < h-1 ? stride : size - y*stride) - w) != 0)
+            return -1;
+    }
+    return m;
+}
+
+static int compareISA(int isa, const unsigned char* img, int w, int h, int stride)
+{
+    static unsigned char out[MAX_SIZE * MAX_SIZE], outRef[MAX_SIZE * MAX_SIZE];
+    int outstride = w + rnd() % 8;
+    memset(out, 0xcd, sizeof(out));
+    memset(outRef, 0xcd, sizeof(outRef));
+    sdfCoverageToDistanceFieldISA(outRef, outstride, img, w, h, stride, SDF_ISA_SCALAR);
+    sdfCoverageToDistanceFieldISA(out, outstride, img, w, h, stride, isa);
+    return maxDiff(out, outRef, w, h, outstride, sizeof(out));
+}
+
+// Random images with random sizes and strides: noise, flat areas and antialiased edges.
+static void testRandom(const char* name, int isa)
+{
+    static unsigned char img[MAX_SIZE * MAX_SIZE];
+    int i, x, y, w, h, stride, d;
+
+    for (i = 0; i < 2000; i++) {
+        w = 3 + rnd() % 120;
+        h = 3 + rnd() % 120;
+        stride = w + rnd() % 16;
+        int kind = rnd() % 3;
+        for (y = 0; y < h; y++) {
+            for (x = 0; x < stride; x++) {
+                int v = rnd() % 256;
+                if (kind == 1)
+                    v = v < 96 ? 0 : v > 160 ? 255 : v;
+                else if (kind == 2)
+                    v = fons__maxi(0, fons__mini(255, (x - w/2) * 40 + (y - h/2) * 17 + 128));
+                img[y*stride + x] = (unsigned char)v;
+            }
+        }
+        d = compareISA(isa, img, w, h, stride);
+        CHECK(d >= 0 && d <= 1, "%s random %dx%d stride %d kind %d: max difference %d", name, w, h, stride, kind, d);
+    }
+}
+
+// Glyph coverage of the font at several sizes, stb_truetype allocates from the scratch buffer of the context.
+static void testGlyphs(const char* name, int isa, FONScontext* stash, const stbtt_fontinfo* font)
+{
+    static unsigned char img[MAX_SIZE * MAX_SIZE];
+    static const float sizes[] = { 9.0f, 16.0f, 31.0f, 64.0f, 120.0f };
+    const char* chars = "AaBgQ@&%Wj8";
+    int i, c, x0, y0, x1, y1, w, h, stride, d;
+
+    for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        float scale = stbtt_ScaleForPixelHeight(font, sizes[i]);
+        for (c = 0; chars[c]; c++) {
+            stbtt_GetCodepointBitmapBox(font, chars[c], scale, scale, &x0, &y0, &x1, &y1);
+            w = x1 - x0 + 4;
+            h = y1 - y0 + 4;
+            stride = w + 3;
+            memset(img, 0, sizeof(img));
+            stash->nscratch = 0;
+            stbtt_MakeCodepointBitmap(font, &img[2*stride + 2], w - 4, h - 4, stride, scale, scale, chars[c]);
+            d = compareISA(isa, img, w, h, stride);
+            CHECK(d >= 0 && d <= 1, "%s glyph '%c' at %.0fpx: max difference %d", name, chars[c], sizes[i], d);
+        }
+    }
+}
+
+static void drawFastSDF(FONScontext* stash, int font)
+{
+    fonsSetFont(stash, font);
+    fonsSetBlurType(stash, FONS_EFFECT_DISTANCE_FIELD_FAST);
+    fonsSetBlur(stash, 1.0f);
+    fonsSetSize(stash, 18.0f);
+    fonsDrawText(stash, 0, 0, "The quick brown fox jumps", NULL, 1);
+    fonsSetSize(stash, 72.0f);
+    fonsDrawText(stash, 0, 0, "over the lazy dog 0123", NULL, 1);
+}
+
+// FONS_EFFECT_DISTANCE_FIELD_FAST glyphs in the atlas, vector kernel against scalar.
+static void testAtlas(const char* name, int isa, const char* path)
+{
+    FONSparams params;
+    FONScontext* stashes[2];
+    int i, d, font;
+
+    memset(&params, 0, sizeof(params));
+    params.width = 512;
+    params.height = 512;
+    for (i = 0; i < 2; i++) {
+        stashes[i] = fonsCreateInternal(&params);
+        stashes[i]->kernels.sdfIsa = i == 0 ? SDF_ISA_SCALAR : isa;
+        font = fonsAddFont(stashes[i], "serif", path);
+        drawFastSDF(stashes[i], font);
+    }
+
+    d = maxDiff(stashes[1]->texData, stashes[0]->texData, 512, 512, 512, 512 * 512);
+    CHECK(d >= 0 && d <= 1, "%s atlas: max difference %d", name, d);
+
+    for (i = 0; i < 2; i++)
+        fonsDeleteInternal(stashes[i]);
+}
+
+int main(int argc, char* argv[])
+{
+    static const int isas[] = { SDF_ISA_SSE2, SDF_ISA_AVX2, SDF_ISA_NEON };
+    static const char* names[] = { "SSE2", "AVX2", "NEON" };
+    static const int features[] = { FONS_CPU_SSE2, FONS_CPU_AVX2, FONS_CPU_NEON };
+    int cpu = fons__cpuFeatures();
+    int i, font, ntested = 0;
+    FONSparams params;
+    FONScontext* stash;
+
+    seed = 29;
+    if (argc < 2) {
+        printf("usage: %s font.ttf\n", argv[0]);
+        return 2;
+    }
+    memset(&params, 0, sizeof(params));
+    params.width = 64;
+    params.height = 64;
+    stash = fonsCreateInternal(&params);
+    font = fonsAddFont(stash, "serif", argv[1]);
+    if (font == FONS_INVALID) {
+        printf("could not load %s\n", argv[1]);
+        fonsDeleteInternal(stash);
+        return 2;
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (!sdfHasISA(isas[i]) || !(cpu & features[i]))
+            continue;
+        testRandom(names[i], isas[i]);
+        testGlyphs(names[i], isas[i], stash, &stash->fonts[font]->font.font);
+        testAtlas(names[i], isas[i], argv[1]);
+        ntested++;
+    }
+
+    fonsDeleteInternal(stash);
+    printf("%d instruction sets checked, %d failures\n", ntested, nfailed);
+    return nfailed == 0 ? 0 : 1;
+}
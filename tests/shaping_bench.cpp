@@ -0,0 +1,168 @@
+//
+// Times drawing map labels, Zipf distributed street names with a share of Arabic and Devanagari ones, with
+// shaping cache hits and with every label shaped again. Built with FONS_SHAPING_BYPASS_MAX 0 every label is
+// shaped by HarfBuzz, otherwise the simple Latin-1 ones skip it.
+// Usage: shaping_bench latin.ttf arabic.ttf devanagari.ttf [latin share] [repeats]
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <hb.h>
+#include <hb-ft.h>
+
+#define FONS_USE_FREETYPE
+#define FONS_USE_HARFBUZZ
+#define FONTSTASH_IMPLEMENTATION
+#include "fontstash.h"
+
+#define MAX_LABELS 256
+#define NDRAWS 50000
+#define LABEL_SIZE 18.0f
+
+struct Label
+{
+    char text[64];
+    int font;
+};
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void renderDraw(void* uptr, const float* verts, const float* tcoords, const unsigned int* colors, int nverts)
+{
+    FONS_NOTUSED(uptr);
+    FONS_NOTUSED(verts);
+    FONS_NOTUSED(tcoords);
+    FONS_NOTUSED(colors);
+    FONS_NOTUSED(nverts);
+}
+
+static void clearShapingCache(FONScontext* stash)
+{
+    FONSshapingCache* cache = &stash->shaping->cache;
+    int i;
+    cache->nentries = 0;
+    cache->narena = 0;
+    for (i = 0; i < FONS_HASH_LUT_SIZE; i++)
+        cache->lut[i] = -1;
+}
+
+// Street names of the Latin font, then numbered names of the other two.
+static int makeLabels(Label* labels, const int* fonts, int* nlatin)
+{
+    static const char* names[] = {
+        "Main", "Oak", "Pine", "Maple", "Cedar", "Elm", "Washington", "Lake", "Hill", "Park", "Church", "Mill", "River",
+        "Station", "Victoria", "Rue de la Paix", "Champs-\xc3\x89lys\xc3\xa9""es", "Stra\xc3\x9f""e", "Caf\xc3\xa9", "Office",
+    };
+    static const char* kinds[] = { "Street", "Avenue", "Road", "Boulevard", "Lane", "Drive", "Way", "Place" };
+    static const char* arabic[] = {
+        "\xd8\xb4\xd8\xa7\xd8\xb1\xd8\xb9 \xd8\xa7\xd9\x84\xd9\x85\xd9\x84\xd9\x83",
+        "\xd8\xb4\xd8\xa7\xd8\xb1\xd8\xb9 \xd8\xa7\xd9\x84\xd9\x86\xd9\x8a\xd9\x84",
+        "\xd9\x85\xd9\x8a\xd8\xaf\xd8\xa7\xd9\x86 \xd8\xa7\xd9\x84\xd8\xaa\xd8\xad\xd8\xb1\xd9\x8a\xd8\xb1",
+    };
+    static const char* devanagari[] = {
+        "\xe0\xa4\xa8\xe0\xa4\xae\xe0\xa4\xb8\xe0\xa5\x8d\xe0\xa4\xa4\xe0\xa5\x87",
+        "\xe0\xa4\xae\xe0\xa4\xbe\xe0\xa4\xb0\xe0\xa5\x8d\xe0\xa4\x97",
+        "\xe0\xa4\xa6\xe0\xa4\xbf\xe0\xa4\xb2\xe0\xa5\x8d\xe0\xa4\xb2\xe0\xa5\x80",
+    };
+    int i, j, n = 0;
+
+    for (i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        for (j = 0; j < (int)(sizeof(kinds) / sizeof(kinds[0])); j++, n++) {
+            snprintf(labels[n].text, sizeof(labels[n].text), "%s %s", names[i], kinds[j]);
+            labels[n].font = fonts[0];
+        }
+    }
+    *nlatin = n;
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 10; j++, n += 2) {
+            snprintf(labels[n].text, sizeof(labels[n].text), "%s %d", arabic[i], j);
+            labels[n].font = fonts[1];
+            snprintf(labels[n+1].text, sizeof(labels[n+1].text), "%s %d", devanagari[i], j);
+            labels[n+1].font = fonts[2];
+        }
+    }
+    return n;
+}
+
+// Best microseconds per label of drawing the sequence.
+static double timeLabels(FONScontext* stash, const Label* labels, const int* draws, int uncached, int repeats)
+{
+    double t, best = 1e30;
+    int i, r;
+
+    for (r = 0; r < repeats; r++) {
+        t = now();
+        for (i = 0; i < NDRAWS; i++) {
+            if (uncached)
+                clearShapingCache(stash);
+            fonsSetFont(stash, labels[draws[i]].font);
+            fonsSetShaping(stash);
+            fonsDrawText(stash, 0, 0, labels[draws[i]].text, NULL, 1);
+        }
+        t = (now() - t) * 1e6 / NDRAWS;
+        best = t < best ? t : best;
+    }
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    static Label labels[MAX_LABELS];
+    static int draws[NDRAWS];
+    FONSparams params;
+    FONScontext* stash;
+    int i, fonts[3], nlabels, nlatin, repeats = 5;
+    float latinShare = 0.9f, u;
+
+    if (argc < 4) {
+        printf("usage: %s latin.ttf arabic.ttf devanagari.ttf [latin share] [repeats]\n", argv[0]);
+        return 2;
+    }
+    if (argc > 4)
+        latinShare = (float)atof(argv[4]);
+    if (argc > 5)
+        repeats = fons__maxi(atoi(argv[5]), 1);
+
+    memset(&params, 0, sizeof(params));
+    params.width = 1024;
+    params.height = 1024;
+    params.renderDraw = renderDraw;
+    stash = fonsCreateInternal(&params);
+    for (i = 0; i < 3; i++) {
+        fonts[i] = fonsAddFont(stash, "label", argv[i+1]);
+        if (fonts[i] == FONS_INVALID) {
+            printf("could not load %s\n", argv[i+1]);
+            fonsDeleteInternal(stash);
+            return 2;
+        }
+    }
+
+    srand(1);
+    nlabels = makeLabels(labels, fonts, &nlatin);
+    for (i = 0; i < NDRAWS; i++) {
+        u = (float)(rand() % 65536) / 65536.0f;
+        u = u * u * u;
+        if ((float)(rand() % 65536) / 65536.0f < latinShare)
+            draws[i] = (int)(u * nlatin);
+        else
+            draws[i] = nlatin + (int)(u * (nlabels - nlatin));
+    }
+
+    fonsSetSize(stash, LABEL_SIZE);
+    timeLabels(stash, labels, draws, 0, 1);
+
+    printf("bypass up to U+%04X, latin %.0f%%, us per label\n", FONS_SHAPING_BYPASS_MAX, latinShare * 100.0f);
+    printf("cache hits %.2f\n", timeLabels(stash, labels, draws, 0, repeats));
+    printf("shaped every time %.2f\n", timeLabels(stash, labels, draws, 1, repeats));
+
+    fonsDeleteInternal(stash);
+    return 0;
+}
@@ -0,0 +1,125 @@
+//
+// Strings shaped without HarfBuzz (fons__simpleShape) get the same glyphs, clusters, advances and offsets as when
+// HarfBuzz shapes them, which is what FONS_SHAPING_BYPASS_MAX 0 does for every string, whole and in parts.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <hb.h>
+#include <hb-ft.h>
+
+#define FONS_USE_FREETYPE
+#define FONS_USE_HARFBUZZ
+#define FONTSTASH_IMPLEMENTATION
+#include "fontstash.h"
+#include "test.h"
+
+#define MAX_GLYPHS 128
+
+struct Result
+{
+    FONSshapingRes res;
+    uint32_t codepoints[MAX_GLYPHS];
+    float advance[MAX_GLYPHS*2];
+    float offset[MAX_GLYPHS*2];
+    uint32_t clusters[MAX_GLYPHS];
+};
+
+static void initResult(Result* r, unsigned int glyphCount)
+{
+    memset(r, 0, sizeof(*r));
+    r->res.glyphCount = glyphCount;
+    r->res.codepoints = r->codepoints;
+    r->res.advance = r->advance;
+    r->res.offset = r->offset;
+    r->res.clusters = r->clusters;
+}
+
+// Shapes the bytes [offset, offset+length) of the string both ways, returns 0 if the string needs HarfBuzz.
+static int compare(FONScontext* stash, FONSfont* font, const char* text, int offset, int length, short isize)
+{
+    FONShbFontShaper* shaper = (FONShbFontShaper*)font->font.shaper;
+    int len = (int)strlen(text);
+    unsigned int count, hbCount, i;
+    float width = 0.0f, hbWidth = 0.0f;
+    Result simple, shaped;
+
+    count = fons__simpleRun(stash->shaping, font, text + offset, length);
+    if (count == 0 || count > MAX_GLYPHS) return 0;
+    initResult(&simple, count);
+    fons__simpleShape(font, shaper->face, text, len, offset, length, isize, &simple.res);
+
+    hbCount = fons__hbShapeText(shaper, stash->shaping, text, len, offset, length, isize);
+    CHECK(hbCount == count, "'%s' [%d,%d) %dpx/10: %u glyphs, HarfBuzz %u", text, offset, offset+length, isize, count, hbCount);
+    if (hbCount != count) return 1;
+    initResult(&shaped, hbCount);
+    fons__hbStoreGlyphs(shaper, &shaped.res);
+
+    for (i = 0; i < count; i++) {
+        width += simple.advance[i*2];
+        hbWidth += shaped.advance[i*2];
+        CHECK(simple.codepoints[i] == shaped.codepoints[i] && simple.clusters[i] == shaped.clusters[i]
+              && memcmp(&simple.advance[i*2], &shaped.advance[i*2], sizeof(float)*2) == 0
+              && memcmp(&simple.offset[i*2], &shaped.offset[i*2], sizeof(float)*2) == 0,
+              "'%s' [%d,%d) %dpx/10 glyph %u: %u at %u advance %.0f offset %.0f,%.0f, HarfBuzz %u at %u advance %.0f offset %.0f,%.0f",
+              text, offset, offset+length, isize, i, simple.codepoints[i], simple.clusters[i], simple.advance[i*2],
+              simple.offset[i*2], simple.offset[i*2+1], shaped.codepoints[i], shaped.clusters[i], shaped.advance[i*2],
+              shaped.offset[i*2], shaped.offset[i*2+1]);
+    }
+    CHECK(width == hbWidth, "'%s' [%d,%d) %dpx/10: width %.2fpx, HarfBuzz %.2fpx", text, offset, offset+length, isize,
+          width / 64.0f, hbWidth / 64.0f);
+    return 1;
+}
+
+int main(int argc, char* argv[])
+{
+    static const char* strings[] = {
+        "AVATAR Way", "Main Street", "Washington Avenue", "To Yy Wa Av LT", "Caf\xc3\xa9 de la Paix",
+        "Stra\xc3\x9f""e 12", "Champs-\xc3\x89lys\xc3\xa9""es", "P.O. Box 1024", "\xc2\xbfQu\xc3\xa9 tal?", "Fjord T\xc3\xa4r",
+    };
+    static const short sizes[] = { 90, 120, 125, 180, 240, 333, 360, 720 };
+    FONSparams params;
+    FONScontext* stash;
+    FONSfont* font;
+    int i, j, k, len, ncompared = 0;
+
+    if (argc < 2) {
+        printf("usage: %s font.ttf\n", argv[0]);
+        return 2;
+    }
+    memset(&params, 0, sizeof(params));
+    params.width = 64;
+    params.height = 64;
+    stash = fonsCreateInternal(&params);
+    i = fonsAddFont(stash, "serif", argv[1]);
+    if (i == FONS_INVALID) {
+        printf("could not load %s\n", argv[1]);
+        fonsDeleteInternal(stash);
+        return 2;
+    }
+    font = stash->fonts[i];
+    fonsSetShaping(stash);
+
+    for (i = 0; i < (int)(sizeof(strings) / sizeof(strings[0])); i++) {
+        len = (int)strlen(strings[i]);
+        for (j = 0; j < (int)(sizeof(sizes) / sizeof(sizes[0])); j++) {
+            ncompared += compare(stash, font, strings[i], 0, len, sizes[j]);
+            // Words of the string, as reshaping an edit does, kerned with the character after them.
+            for (k = 0; k < len; k++) {
+                const char* space = strchr(strings[i] + k, ' ');
+                int end = space ? (int)(space - strings[i]) : len;
+                ncompared += compare(stash, font, strings[i], k, end - k, sizes[j]);
+                k = end;
+            }
+        }
+    }
+    CHECK(ncompared > 100, "only %d strings took the bypass", ncompared);
+
+    fonsDeleteInternal(stash);
+    printf("%d strings compared, %d failures\n", ncompared, nfailed);
+    return nfailed == 0 ? 0 : 1;
+}
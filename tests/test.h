@@ -0,0 +1,25 @@
+//
+// Failure counting and a fixed sequence random generator shared by the tests, each test sets
+// seed to its own value before using rnd().
+//
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+static int nfailed = 0;
+static unsigned int seed = 1;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        if (nfailed++ < 20) { printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } \
+    } \
+} while (0)
+
+static inline unsigned int rnd()
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+#endif // TEST_H